@@ -0,0 +1,30 @@
+// aio.c - a task per file named on the command line, each reading a line
+// from it; reads that would block let the other tasks run
+
+int reader(char *name)
+{
+  int fd, n, t;
+  char *b;
+
+  b = malloc(256);
+  if ((fd = open(name, 2)) < 0) { printf("could not open %s\n", name); return 0; } // a fifo opened read-write does not wait for its writer
+  t = 0; n = 1;
+  while (n > 0 && (n = read(fd, b, 255)) > 0) { t = t + n; if (b[n - 1] == '\n') n = 0; }
+  close(fd);
+  printf("%s: %d bytes\n", name, t);
+  return t;
+}
+
+int main(int argc, char **argv)
+{
+  int i, *t, s;
+
+  t = malloc(argc * sizeof(int));
+  i = 1;
+  while (i < argc) { t[i] = spawn(reader, argv[i]); ++i; }
+  s = 0;
+  i = 1;
+  while (i < argc) { s = s + join(t[i]); ++i; }
+  printf("%d files, %d bytes\n", argc - 1, s);
+  return 0;
+}
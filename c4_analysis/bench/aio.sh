@@ -0,0 +1,28 @@
+#!/bin/sh
+# aio.sh - reads that would block suspend a task, not the process
+#
+# usage: sh aio.sh [c4 binary] [fifos]
+# Starts bench/aio.c on the given number of fifos (default 8). Their writers
+# fire in reverse order, 0.1s apart, so the readers finish last file first;
+# with blocking reads they would all queue behind the first file's.
+
+C4=${1:-./c4}
+N=${2:-8}
+DIR=$(dirname "$0")
+TMP=${TMPDIR:-/tmp}/c4_aio.$$
+
+mkdir -p "$TMP"
+i=1; files=
+while [ $i -le $N ]; do mkfifo "$TMP/f$i"; files="$files $TMP/f$i"; i=$((i + 1)); done
+t0=$(date +%s%N)
+$C4 "$DIR/aio.c" $files > "$TMP/out" &
+pid=$!
+i=1
+while [ $i -le $N ]; do
+  (sleep $(awk "BEGIN { print ($N - $i) / 10 }"); echo "line $i" > "$TMP/f$i") &
+  i=$((i + 1))
+done
+wait
+sed "s|$TMP/||" "$TMP/out"
+echo "$(( ($(date +%s%N) - t0) / 1000000 )) ms"
+rm -rf "$TMP"
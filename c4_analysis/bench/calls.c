@@ -0,0 +1,32 @@
+// calls.c - a token classifier built from tiny predicates and accessors
+
+char *buf;
+int len, *cnt;
+
+int isdigit(int c) { return c >= '0' && c <= '9'; }
+int isalpha(int c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+int at(int i) { return buf[i]; }
+int bump(int k) { cnt[k] = cnt[k] + 1; return k; }
+
+int main()
+{
+  int i, c, tokens;
+
+  len = 100000;
+  buf = malloc(len + 1);
+  cnt = malloc(3 * sizeof(int));
+  i = 0;
+  while (i < len) { buf[i] = "int x1 = y_2 + 305; "[i % 20]; ++i; }
+  buf[len] = 0;
+  cnt[0] = cnt[1] = cnt[2] = 0;
+  tokens = 0;
+  i = 0;
+  while (at(i)) {
+    c = at(i);
+    if (isalpha(c)) { while (isalpha(at(i)) || isdigit(at(i))) ++i; bump(0); ++tokens; }
+    else if (isdigit(c)) { while (isdigit(at(i))) ++i; bump(1); ++tokens; }
+    else { if (c != ' ') { bump(2); ++tokens; } ++i; }
+  }
+  printf("%d tokens: %d names, %d numbers, %d other\n", tokens, cnt[0], cnt[1], cnt[2]);
+  return 0;
+}
@@ -0,0 +1,48 @@
+// cond.c - a lexer-style scan dominated by && and || tests
+
+char *buf;
+int len;
+
+int main()
+{
+  int i, j, c, words, nums, ops, lines, r;
+
+  len = 200000;
+  buf = malloc(len + 1);
+  i = 0; r = 7;
+  while (i < len) {
+    r = (r * 1103515245 + 12345) & 0x7fffffff;
+    c = r % 11;
+    if (c < 4) buf[i] = 'a' + r % 26;
+    else if (c < 6) buf[i] = '0' + r % 10;
+    else if (c < 8) buf[i] = ' ';
+    else if (c < 9) buf[i] = '\n';
+    else buf[i] = "+-*/_<>"[r % 7];
+    ++i;
+  }
+  buf[len] = 0;
+  words = nums = ops = lines = 0;
+  j = 0;
+  while (j < 5) {
+    i = 0;
+    while (i < len && buf[i]) {
+      c = buf[i];
+      if (c >= 'a' && c <= 'z' || c >= 'A' && c <= 'Z' || c == '_') {
+        while (i < len && (buf[i] >= 'a' && buf[i] <= 'z' || buf[i] >= '0' && buf[i] <= '9' || buf[i] == '_')) ++i;
+        ++words;
+      }
+      else if (c >= '0' && c <= '9') {
+        while (i < len && buf[i] >= '0' && buf[i] <= '9') ++i;
+        ++nums;
+      }
+      else {
+        if (c == '\n') ++lines;
+        else if (c != ' ' && c != '\t') ++ops;
+        ++i;
+      }
+    }
+    ++j;
+  }
+  printf("%d words %d numbers %d operators %d lines\n", words, nums, ops, lines);
+  return 0;
+}
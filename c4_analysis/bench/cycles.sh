@@ -0,0 +1,18 @@
+#!/bin/sh
+# cycles.sh - compare VM cycle counts and run time across c4 options
+#
+# usage: sh cycles.sh [c4 binary] [options...]
+# Runs every benchmark program once plain and once with the given options
+# (default -O) and prints the cycle totals reported at exit.
+
+C4=${1:-./c4}
+[ $# -gt 0 ] && shift
+OPTS=${*:--O}
+DIR=$(dirname "$0")
+
+printf '%-10s %14s %14s %8s\n' program plain "$OPTS" ratio
+for f in fib sieve strscan matrix sort calls cond; do
+  a=$($C4 "$DIR/$f.c" | sed -n 's/.*cycle = //p')
+  b=$($C4 $OPTS "$DIR/$f.c" | sed -n 's/.*cycle = //p')
+  echo "$f $a $b" | awk '{ printf "%-10s %14d %14d %8.2f\n", $1, $2, $3, $3 / $2 }'
+done
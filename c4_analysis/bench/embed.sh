@@ -0,0 +1,78 @@
+#!/bin/sh
+# embed.sh - different programs running at once in one process, through c4.h
+#
+# usage: sh embed.sh [runs]
+# Builds a small host against c4_modified.c -DC4LIB that compiles each
+# benchmark program into a context of its own, then makes the given number
+# of runs (default 8) of each: one program at a time, and then all of them at
+# once, a thread each. Prints both wall times and the speedup.
+
+RUNS=${1:-8}
+DIR=$(dirname "$0")
+TMP=${TMPDIR:-/tmp}/c4_embed.$$
+
+cat > "$TMP.c" <<'EOF'
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "c4.h"
+
+long long *prog[16], runs;
+
+void *runs_of(void *i)
+{
+  long long *vm, k, r;
+  char *argv[] = { "embed", 0 };
+
+  if (!(vm = vmnew(prog[(long)i]))) return (void *)-1;
+  r = 0; k = 0;
+  while (k++ < runs) r = r | vmrun(vm, 1, argv);
+  vmfree(vm);
+  return (void *)r;
+}
+
+long long us(struct timespec *t0)
+{
+  struct timespec t1;
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  return (t1.tv_sec - t0->tv_sec) * 1000000 + (t1.tv_nsec - t0->tv_nsec) / 1000;
+}
+
+int main(int argc, char **argv)
+{
+  pthread_t th[16];
+  struct timespec t0;
+  long long n, i, one, all;
+  void *r;
+  char *s;
+  FILE *f;
+
+  runs = atoi(argv[1]);
+  n = 0;
+  while (n + 2 < argc && n < 16) {
+    if (!(f = fopen(argv[n + 2], "r")) || !(s = calloc(1, 1 << 20))) return 1;
+    fread(s, 1, (1 << 20) - 1, f); fclose(f);
+    prog[n] = c4new();
+    if (c4compile(prog[n], s) < 0) return 1;
+    free(s);
+    ++n;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  i = 0;
+  while (i < n) { pthread_create(th, 0, runs_of, (void *)i); pthread_join(th[0], &r); if (r) return 1; ++i; }
+  one = us(&t0);
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  i = 0; while (i < n) { pthread_create(th + i, 0, runs_of, (void *)i); ++i; }
+  i = 0; while (i < n) { pthread_join(th[i++], &r); if (r) return 1; }
+  all = us(&t0);
+  fprintf(stderr, "%lld programs, %lld runs each: one at a time %lld us, all at once %lld us, %.2fx\n",
+    n, runs, one, all, (double)one / all);
+  i = 0; while (i < n) c4free(prog[i++]);
+  return 0;
+}
+EOF
+${CC:-cc} -O2 -I"$DIR/.." -o "$TMP" "$TMP.c" -DC4LIB "$DIR/../c4_modified.c" -lpthread -w &&
+  "$TMP" "$RUNS" "$DIR/fib.c" "$DIR/sieve.c" "$DIR/matrix.c" "$DIR/sort.c" "$DIR/calls.c" "$DIR/tasks.c" > /dev/null
+rm -f "$TMP" "$TMP.c"
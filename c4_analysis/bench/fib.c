@@ -0,0 +1,13 @@
+// fib.c - call-heavy recursion
+
+int fib(int n)
+{
+  if (n < 2) return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+int main()
+{
+  printf("fib(25) = %d\n", fib(25));
+  return 0;
+}
@@ -0,0 +1,28 @@
+#!/bin/sh
+# jitcheck.sh - run every benchmark interpreted, under the JIT and as an
+# executable written by -o, and compare
+#
+# usage: sh jitcheck.sh [c4 binary] [options...]
+# Output must match apart from the cycle count, which native code does not
+# keep, and the exit line, which executables do not print; the run times
+# are printed side by side.
+
+C4=${1:-./c4}
+[ $# -gt 0 ] && shift
+DIR=$(dirname "$0")
+EXE=${TMPDIR:-/tmp}/jitcheck.$$
+fail=0
+
+printf '%-10s %10s %10s %10s\n' program interp jit aot
+for f in fib sieve strscan matrix sort calls cond; do
+  $C4 "$@" -o $EXE "$DIR/$f.c" > /dev/null || { echo "$f: -o failed"; fail=1; continue; }
+  t0=$(date +%s%N); a=$($C4 "$@" "$DIR/$f.c" | sed 's/ cycle = [0-9]*//')
+  t1=$(date +%s%N); b=$($C4 -j "$@" "$DIR/$f.c" | sed 's/ cycle = [0-9]*//')
+  t2=$(date +%s%N); c=$($EXE; echo "exit($?)")
+  t3=$(date +%s%N)
+  [ "$a" = "$b" ] || { echo "$f: jit output differs"; fail=1; }
+  [ "$a" = "$c" ] || { echo "$f: executable output differs"; fail=1; }
+  printf '%-10s %8dms %8dms %8dms\n' $f $(((t1 - t0) / 1000000)) $(((t2 - t1) / 1000000)) $(((t3 - t2) / 1000000))
+done
+rm -f $EXE
+exit $fail
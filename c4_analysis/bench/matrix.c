@@ -0,0 +1,37 @@
+// matrix.c - integer matrix multiply through int arrays
+
+int n;
+
+int *alloc(int v)
+{
+  int *m, i;
+  m = malloc(n * n * sizeof(int));
+  i = 0;
+  while (i < n * n) { m[i] = (i * v) % 7 - 3; ++i; }
+  return m;
+}
+
+int main()
+{
+  int *a, *b, *c, i, j, k, s;
+
+  n = 60;
+  a = alloc(1); b = alloc(3); c = alloc(0);
+  i = 0;
+  while (i < n) {
+    j = 0;
+    while (j < n) {
+      s = 0;
+      k = 0;
+      while (k < n) { s = s + a[i * n + k] * b[k * n + j]; ++k; }
+      c[i * n + j] = s;
+      ++j;
+    }
+    ++i;
+  }
+  s = 0;
+  i = 0;
+  while (i < n * n) { s = s ^ c[i] + i; ++i; }
+  printf("checksum %d\n", s);
+  return 0;
+}
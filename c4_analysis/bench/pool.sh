@@ -0,0 +1,23 @@
+#!/bin/sh
+# pool.sh - throughput of -P as workers are added
+#
+# usage: sh pool.sh [c4 binary] [runs]
+# Runs each benchmark program the given number of times (default 64) on 1, 2,
+# 4, ... workers up to the online cpus and prints runs per second and the
+# speedup over one worker, from the pool's own wall clock timing.
+
+C4=${1:-./c4}
+RUNS=${2:-64}
+DIR=$(dirname "$0")
+CPUS=$(getconf _NPROCESSORS_ONLN)
+
+printf '%-10s %7s %10s %8s\n' program workers runs/s speedup
+for f in fib sieve matrix sort calls; do
+  w=1
+  while [ $w -le $CPUS ]; do
+    us=$($C4 -t -P$RUNS:$w "$DIR/$f.c" | sed -n 's/^pool:.* \([0-9]*\) us$/\1/p')
+    [ $w -eq 1 ] && us1=$us
+    echo "$f $w $RUNS $us $us1" | awk '{ printf "%-10s %7d %10.1f %8.2f\n", $1, $2, $3 * 1000000 / $4, $5 / $4 }'
+    [ $w -lt $CPUS ] && [ $((w * 2)) -gt $CPUS ] && w=$CPUS || w=$((w * 2))
+  done
+done
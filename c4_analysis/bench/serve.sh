@@ -0,0 +1,40 @@
+#!/bin/sh
+# serve.sh - request latency of the fork server (-S) against a fresh c4 per run
+#
+# usage: sh serve.sh [c4 binary] [requests]
+# Times runs of a generated 4000-identifier program (all compile, little
+# run) and of a few benchmark programs: a tenth of the given number of runs
+# (default 1000) started as new processes with -C, then all of them as
+# requests to a fork server, and prints the server's own latency
+# percentiles. Needs python3 for the socket client.
+
+C4=${1:-./c4}
+N=${2:-1000}
+DIR=$(dirname "$0")
+SOCK=${TMPDIR:-/tmp}/c4_serve.$$
+
+$C4 -C "$DIR/symgen.c" 4000 | sed '$d' > "$SOCK.c"
+for f in "$SOCK.c" "$DIR/fib.c" "$DIR/calls.c"; do
+  t0=$(date +%s%N)
+  i=0
+  while [ $i -lt $((N / 10)) ]; do $C4 -C "$f" > /dev/null; i=$((i + 1)); done
+  echo "$(basename "$f" | sed "s/^c4_serve.*/symgen 4000/"): process per run $(( ($(date +%s%N) - t0) / (N / 10) / 1000 )) us"
+  $C4 -S "$SOCK" "$f" > "$SOCK.log" &
+  pid=$!
+  while [ ! -S "$SOCK" ]; do sleep 0.01; done
+  python3 - "$SOCK" "$N" <<'PY'
+import socket, sys, time
+path, n = sys.argv[1], int(sys.argv[2])
+t0 = time.monotonic()
+for i in range(n):
+    s = socket.socket(socket.AF_UNIX)
+    s.connect(path)
+    s.sendall(b'\n')
+    while s.recv(65536): pass
+    s.close()
+print('%d us per request at the client' % ((time.monotonic() - t0) * 1e6 / n))
+PY
+  kill -INT $pid; wait $pid
+  sed -n 's/^serve: /  /p' "$SOCK.log"
+done
+rm -f "$SOCK.log" "$SOCK.c"
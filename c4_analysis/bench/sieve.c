@@ -0,0 +1,27 @@
+// sieve.c - sieve of Eratosthenes over a char array
+
+int main()
+{
+  char *flags;
+  int n, i, j, count, round;
+
+  n = 200000;
+  flags = malloc(n);
+  round = 0;
+  while (round < 5) {
+    memset(flags, 1, n);
+    count = 0;
+    i = 2;
+    while (i < n) {
+      if (flags[i]) {
+        count = count + 1;
+        j = i + i;
+        while (j < n) { flags[j] = 0; j = j + i; }
+      }
+      i = i + 1;
+    }
+    round = round + 1;
+  }
+  printf("%d primes below %d\n", count, n);
+  return 0;
+}
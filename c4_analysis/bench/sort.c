@@ -0,0 +1,24 @@
+// sort.c - bubble sort over an int array, swapping through a[j] and a[j + 1]
+
+int main()
+{
+  int *a, n, i, j, t, s;
+
+  n = 2000;
+  a = malloc(n * sizeof(int));
+  i = 0; s = 12345;
+  while (i < n) { s = (s * 1103515245 + 12345) & 2147483647; a[i] = s % 10000; ++i; }
+  i = 0;
+  while (i < n - 1) {
+    j = 0;
+    while (j < n - 1 - i) {
+      if (a[j] > a[j + 1]) { t = a[j]; a[j] = a[j + 1]; a[j + 1] = t; }
+      ++j;
+    }
+    ++i;
+  }
+  s = 0; i = 0;
+  while (i < n) { s = s * 31 + a[i]; ++i; }
+  printf("checksum %d\n", s);
+  return 0;
+}
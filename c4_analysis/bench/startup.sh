@@ -0,0 +1,29 @@
+#!/bin/sh
+# startup.sh - cold (compiling) against warm (cached image) start times
+#
+# usage: sh startup.sh [c4 binary]
+# Generates programs of growing size with symgen.c and prints the best of
+# three runs of each with -C (always compile) and with the image cache warm.
+
+C4=${1:-./c4}
+DIR=$(dirname "$0")
+TMP=${TMPDIR:-/tmp}/c4_startup.$$
+
+best() {
+  b=
+  for r in 1 2 3; do
+    t0=$(date +%s%N)
+    $C4 "$@" > /dev/null
+    t=$(( ($(date +%s%N) - t0) / 1000 ))
+    [ -z "$b" ] || [ $t -lt $b ] && b=$t
+  done
+  echo $b
+}
+
+printf '%6s %10s %10s\n' idents cold warm
+for n in 1000 4000 16000; do
+  $C4 -C "$DIR/symgen.c" $n | sed '$d' > "$TMP.c"
+  $C4 "$TMP.c" > /dev/null # fill the cache
+  printf '%6d %8dus %8dus\n' $n $(best -C "$TMP.c") $(best "$TMP.c")
+done
+rm -f "$TMP.c"
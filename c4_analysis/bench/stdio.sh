@@ -0,0 +1,34 @@
+#!/bin/sh
+# stdio.sh - buffered program I/O: getline, getchar and printf per line
+#
+# usage: sh stdio.sh [c4 binary] [lines] [options...]
+# Feeds bench/wc.c a generated file (default 200000 lines) and prints the
+# best of three runs in milliseconds for each option set (default -xs -xt
+# -xr -j), reading by line and by character.
+
+C4=${1:-./c4}
+N=${2:-200000}
+[ $# -gt 1 ] && shift 2 || shift $#
+[ $# -gt 0 ] || set -- -xs -xt -xr -j
+DIR=$(dirname "$0")
+TMP=${TMPDIR:-/tmp}/c4_stdio.$$
+
+awk -v n=$N 'BEGIN { for (i = 0; i < n; i++) print "word " i " another word " i * 7 }' > "$TMP"
+printf '%-10s' read
+for o in "$@"; do printf ' %10s' "$o"; done
+echo
+for m in getline getchar; do
+  printf '%-10s' $m
+  for o in "$@"; do
+    best=
+    for r in 1 2 3; do
+      t0=$(date +%s%N)
+      if [ $m = getline ]; then $C4 $o "$DIR/wc.c" < "$TMP" > /dev/null; else $C4 $o "$DIR/wc.c" c < "$TMP" > /dev/null; fi
+      t=$(( ($(date +%s%N) - t0) / 1000000 ))
+      [ -z "$best" ] || [ $t -lt $best ] && best=$t
+    done
+    printf ' %10s' $best
+  done
+  echo
+done
+rm -f "$TMP"
@@ -0,0 +1,28 @@
+// strscan.c - character counting over a long string
+
+char *buf;
+int len;
+
+int count(char *s, int c)
+{
+  int n;
+  n = 0;
+  while (*s) { if (*s == c) ++n; ++s; }
+  return n;
+}
+
+int main()
+{
+  int i, total;
+
+  len = 100000;
+  buf = malloc(len + 1);
+  i = 0;
+  while (i < len) { buf[i] = 'a' + i % 26; ++i; }
+  buf[len] = 0;
+  total = 0;
+  i = 0;
+  while (i < 20) { total = total + count(buf, 'e'); ++i; }
+  printf("%d matches\n", total);
+  return 0;
+}
@@ -0,0 +1,35 @@
+// symgen.c - emit a c4 program with n distinct identifiers
+//
+// usage: c4 symgen.c n > big.c && c4 -t big.c
+// Each identifier is defined once as an enum constant and referenced from a
+// handful of small functions, so compile time is dominated by symbol lookups.
+
+int atoi(char *s)
+{
+  int n;
+  n = 0;
+  while (*s >= '0' && *s <= '9') { n = n * 10 + *s - '0'; ++s; }
+  return n;
+}
+
+int main(int argc, char **argv)
+{
+  int n, i, j;
+
+  n = 1000;
+  if (argc > 1) n = atoi(argv[1]);
+  printf("enum {\n");
+  i = 0;
+  while (i < n) { printf("  sym%d,\n", i); ++i; }
+  printf("};\n\n");
+  i = 0;
+  while (i < n / 32) {
+    printf("int f%d(int x)\n{\n  return x", i);
+    j = 0;
+    while (j < 8) { printf(" + sym%d", (i * 32 + j * 7919) % n); ++j; }
+    printf(";\n}\n\n");
+    ++i;
+  }
+  printf("int main()\n{\n  return f0(0) & 255;\n}\n");
+  return 0;
+}
@@ -0,0 +1,18 @@
+#!/bin/sh
+# symtab.sh - compile-time symbol table benchmark
+#
+# usage: sh symtab.sh [c4 binary]
+# Generates programs with a growing number of identifiers and prints the
+# compile statistics reported by c4 -t.  With a hashed symbol table the
+# probes/lookup column stays flat as the identifier count grows.
+
+C4=${1:-./c4}
+DIR=$(dirname "$0")
+TMP=${TMPDIR:-/tmp}/c4_symtab.$$
+
+for n in 1000 2000 4000 8000 16000; do
+  $C4 "$DIR/symgen.c" $n | sed '$d' > "$TMP.c"
+  printf '%6d: ' $n
+  $C4 -t "$TMP.c" | head -1
+done
+rm -f "$TMP.c"
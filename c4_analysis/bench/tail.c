@@ -0,0 +1,33 @@
+// tail.c - tail-recursive list walk and state machine, 10M calls deep
+// (about 320 MB of VM stack without tail calls, constant with them)
+
+int *list;
+
+// sum of the list from node p on; a node is (value, next)
+int walk(int *p, int s)
+{
+  if (!p) return s;
+  return walk((int *)p[1], s + *p);
+}
+
+// run a three-state machine over n steps
+int step(int state, int n, int acc)
+{
+  if (!n) return acc;
+  if (state == 0) return step(1, n - 1, acc + 1);
+  if (state == 1) return step(2, n - 1, acc * 3 % 1000003);
+  return step(0, n - 1, acc ^ n);
+}
+
+int main()
+{
+  int i, n, *p;
+
+  n = 1000000;
+  list = 0;
+  i = 0;
+  while (i < n) { p = malloc(2 * sizeof(int)); p[0] = i % 7; p[1] = (int)list; list = p; ++i; }
+  printf("walk %d\n", walk(list, 0));
+  printf("step %d\n", step(0, 10000000, 1));
+  return 0;
+}
@@ -0,0 +1,26 @@
+// tasks.c - many green threads taking turns through yield()
+
+int sum;
+
+int task(int n)
+{
+  int i;
+  i = 0;
+  while (i < 8) { sum = sum + n; yield(); ++i; }
+  return n;
+}
+
+int main()
+{
+  int n, i, *t, s;
+
+  n = 10000;
+  t = malloc(n * sizeof(int));
+  i = 0;
+  while (i < n) { t[i] = spawn(task, i); ++i; }
+  s = 0;
+  i = 0;
+  while (i < n) { s = s + join(t[i]); ++i; }
+  printf("%d tasks: sum %d, joined %d\n", n, sum, s);
+  return 0;
+}
@@ -0,0 +1,29 @@
+#!/bin/sh
+# time.sh - wall-clock time of each benchmark under several option sets
+#
+# usage: sh time.sh [c4 binary] "options" "options" ...
+# e.g.   sh time.sh ./c4 -xs -xt
+# Prints the best of three runs in milliseconds for every option set.
+
+C4=${1:-./c4}
+[ $# -gt 0 ] && shift
+[ $# -gt 0 ] || set -- -xs -xt
+DIR=$(dirname "$0")
+
+printf '%-10s' program
+for o in "$@"; do printf ' %10s' "$o"; done
+echo
+for f in fib sieve strscan matrix; do
+  printf '%-10s' $f
+  for o in "$@"; do
+    best=
+    for r in 1 2 3; do
+      t0=$(date +%s%N)
+      $C4 $o "$DIR/$f.c" > /dev/null
+      t=$(( ($(date +%s%N) - t0) / 1000000 ))
+      [ -z "$best" ] || [ $t -lt $best ] && best=$t
+    done
+    printf ' %10s' $best
+  done
+  echo
+done
@@ -0,0 +1,27 @@
+// wc.c - line, word and byte counts of stdin, read with getline() or, given
+// an argument, getchar(), and every line echoed numbered through printf
+
+int main(int argc, char **argv)
+{
+  char *s, *p;
+  int l, w, b, n, c, in;
+
+  s = malloc(4096);
+  l = w = b = in = 0;
+  if (argc > 1) {
+    while ((c = getchar()) >= 0) {
+      ++b;
+      if (c == '\n') { ++l; printf("%d\n", l); }
+      if (c == ' ' || c == '\t' || c == '\n') in = 0; else if (!in) { in = 1; ++w; }
+    }
+  }
+  else {
+    while ((n = getline(s, 4096)) > 0) {
+      b = b + n; p = s;
+      while (*p) { if (*p == ' ' || *p == '\t' || *p == '\n') in = 0; else if (!in) { in = 1; ++w; } ++p; }
+      if (s[n - 1] == '\n') { ++l; printf("%d: %s", l, s); }
+    }
+  }
+  printf("%d %d %d\n", l, w, b);
+  return 0;
+}
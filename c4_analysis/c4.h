@@ -0,0 +1,31 @@
+// c4.h - c4 as a library
+//
+// Build c4_modified.c with -DC4LIB (which leaves out main) and link it in,
+// with -lpthread. A context holds one program: compile it once, then make
+// instances of it and run them, as many as needed and on any threads. Each
+// instance has globals and a stack of its own and shares the compiled code.
+// Compiles take a lock; runs do not.
+//
+//   cx = c4new();
+//   if (c4compile(cx, src) < 0) ...;   // errors are printed
+//   vm = vmnew(cx);                    // 0 if it could not be mapped
+//   r = vmrun(vm, argc, argv);         // main's exit code; again as often as needed
+//   vmfree(vm);
+//   c4free(cx);                        // once its instances are freed
+//
+// Programs print to stdout and read stdin. Compiles use the default options
+// (no -O, -i or -L). Only the six functions below are exported; the rest of
+// c4_modified.c is static.
+
+#ifndef C4_H
+#define C4_H
+
+long long *c4new(void);
+long long c4compile(long long *cx, char *src); // src is NUL terminated
+void c4free(long long *cx);
+
+long long *vmnew(long long *cx);
+long long vmrun(long long *vm, long long argc, char **argv);
+void vmfree(long long *vm);
+
+#endif
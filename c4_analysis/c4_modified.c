@@ -11,21 +11,78 @@
 #include <memory.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <poll.h>
 #define int long long
 
-char *p, *lp, // current position in source code
-     *data;   // data/bss pointer
+static char *p, *lp, // current position in source code
+     *pe,     // end of the source buffer (word reads stay below it)
+     *data,   // data/bss pointer
+     *rodata, // end of the read-only string literal section
+     *rodat0, // start of the read-only section
+     *data0,  // start of the data section
+     *aotout; // executable to write (-o)
 
-int *e, *le,  // current position in emitted code
+static int *e, *le,  // current position in emitted code
     *id,      // currently parsed identifier
-    *sym,     // symbol table (simple list of identifiers)
+    *sym,     // symbol table (next free identifier slot)
+    *text,    // start of the text area (code starts at text + 1)
+    *hist,    // executed opcode pair counts (-p)
+    *rtext,   // register code (-xr), starting at rtext + 1
+    *re,      // last word of register code emitted
+    *ld,      // last load instruction emitted
+    *lcmp,    // last compare emitted, and the start of its left operand
+    *lcmpb,
+    *lcall,   // last JSR emitted
+    *rsec,    // per text word: the section an address operand points into (RelNone if none)
+    bcx,      // the next expr() compiles a condition into branches
+    *tj, *fj, // its jumps taken when true and when false, chained through their operands
+    *ccb,     // and the start of its last && or || operand
+    ltaken,   // the current function has taken the address of a local
+    ntail,    // tail calls
+    *symh,    // symbol hash buckets (chained through id[Link])
+    symhm,    // number of hash buckets - 1
+    nsym,     // number of identifiers
+    nlook,    // identifier lookups
+    nprobe,   // hash chain entries compared
+    *strh,    // literal intern table: (address, length) pairs, open addressing
+    strhm,    // number of intern slots - 1
+    nstr,     // number of distinct literals
+    nlit,     // number of literals before interning
+    *scope,   // identifiers shadowed by the current function's locals
+    nscope,   // number of entries in scope
+    scopesz,  // capacity of scope
     tk,       // current token
     ival,     // current token value
     ty,       // current expression type
     loc,      // local variable offset
     line,     // current line number
     src,      // print source and assembly flag
-    debug;    // print executed instructions
+    debug,    // print executed instructions
+    stats,    // print compile statistics
+    lexb,     // benchmark the lexer instead of compiling
+    opt,      // run the peephole optimizer (1), and the middle end first (2)
+    engine,   // interpreter: 's'witch, 't'hreaded, 'r'egister or 'c'ompact, or 'j'it
+    npeep0,   // instructions before the peephole optimizer
+    npeep1,   // instructions after it
+    inl,      // inline calls to functions of at most this many instructions (-i)
+    ninl,     // call sites inlined
+    *ent,     // ENT operand of the function being compiled
+    nloc,     // its declared locals and loop temporaries
+    nin,      // frame slots below them taken by the inlined calls in progress
+    loopt,    // rotate, hoist from and unroll while loops (-L)
+    aot,      // compile to an executable (-o): 1, then 2 while its runtime is parsed
+    cache,    // load and save compiled images (off with -C)
+    *rt0,     // first text word of that runtime
+    hugepg;   // back the text and stack arenas with huge pages
 
 // tokens and classes (operators last and in precedence order)
 
@@ -37,33 +94,331 @@ enum {
 };
 
 // opcodes
-enum { LEA ,IMM ,JMP ,JSR ,BZ  ,BNZ ,ENT ,ADJ ,LEV ,LI  ,LC  ,SI  ,SC  ,PSH ,
-       OR  ,XOR ,AND ,EQ  ,NE  ,LT  ,GT  ,LE  ,GE  ,SHL ,SHR ,ADD ,SUB ,MUL ,DIV ,MOD ,NOT
-       OPEN,READ,CLOS,PRTF,MALC,FREE,MSET,MCMP,EXIT };
+// (opcodes up to ADJ take an operand; EQBZ..GEBZ are EQ..GE fused with BZ,
+// DIVS/MODS s are / and % by 2 to the s,
+// LL/LG/SL/SG load and store int locals and globals directly, TSR n; JMP f
+// is a tail call passing n arguments in place of the current frame)
+enum { LEA ,IMM ,JMP ,JSR ,BZ  ,BNZ ,EQBZ,NEBZ,LTBZ,GTBZ,LEBZ,GEBZ,ENT ,ADDI,MULI,DIVI,MODI,DIVS,MODS,SHLI,SHRI,
+       LL  ,LG  ,SL  ,SG  ,TSR ,ADJ ,LEV ,LI  ,LC  ,SI  ,SC  ,PSH ,
+       OR  ,XOR ,AND ,EQ  ,NE  ,LT  ,GT  ,LE  ,GE  ,SHL ,SHR ,ADD ,SUB ,MUL ,DIV ,MOD ,NOT ,
+       NEG ,EQZ ,
+       OPEN,READ,WRIT,CLOS,PRTF,MALC,FREE,MSET,MCMP,SPWN,YLD ,JOIN,GETC,GETL,EXIT };
+
+static char *opname = // five characters per opcode
+  "LEA ,IMM ,JMP ,JSR ,BZ  ,BNZ ,EQBZ,NEBZ,LTBZ,GTBZ,LEBZ,GEBZ,ENT ,ADDI,MULI,DIVI,MODI,DIVS,MODS,SHLI,SHRI,"
+  "LL  ,LG  ,SL  ,SG  ,TSR ,ADJ ,LEV ,LI  ,LC  ,SI  ,SC  ,PSH ,"
+  "OR  ,XOR ,AND ,EQ  ,NE  ,LT  ,GT  ,LE  ,GE  ,SHL ,SHR ,ADD ,SUB ,MUL ,DIV ,MOD ,NOT ,"
+  "NEG ,EQZ ,"
+  "OPEN,READ,WRIT,CLOS,PRTF,MALC,FREE,MSET,MCMP,SPWN,YLD ,JOIN,GETC,GETL,EXIT,";
+
+// register opcodes (-xr): three-address code on registers R[x] = bp[x], so
+// locals and parameters are registers and expression temporaries sit below
+// the locals; grouped by operand count (none, one, two, three)
+enum { RHALT,
+       RJMP ,RJSR ,RENT ,RLEV ,RPSH ,RPSHI,RTSR ,
+       RMOV ,RIMM ,RLEA ,RLI  ,RLC  ,RLG  ,RSG  ,RSI  ,RBZ  ,RBNZ ,RNEG ,REQZ ,RNOT ,RRET ,
+       ROPEN,RREAD,RWRIT,RCLOS,RPRTF,RMALC,RFREE,RMSET,RMCMP,RSPWN,RYLD ,RJOIN,RGETC,RGETL,REXIT,
+       RSC  ,ROR  ,RXOR ,RAND ,REQ  ,RNE  ,RLT  ,RGT  ,RLE  ,RGE  ,RSHL ,RSHR ,RADD ,RSUB ,RMUL ,RDIV ,RMOD ,
+       RADDI,RMULI,RDIVI,RMODI,RDIVS,RMODS,RSHLI,RSHRI,
+       REQBZ,RNEBZ,RLTBZ,RGTBZ,RLEBZ,RGEBZ,REQBI,RNEBI,RLTBI,RGTBI,RLEBI,RGEBI };
+
+static char *rname = // six characters per register opcode
+  "HALT ,"
+  "JMP  ,JSR  ,ENT  ,LEV  ,PSH  ,PSHI ,TSR  ,"
+  "MOV  ,IMM  ,LEA  ,LI   ,LC   ,LG   ,SG   ,SI   ,BZ   ,BNZ  ,NEG  ,EQZ  ,NOT  ,RET  ,"
+  "OPEN ,READ ,WRIT ,CLOS ,PRTF ,MALC ,FREE ,MSET ,MCMP ,SPWN ,YLD  ,JOIN ,GETC ,GETL ,EXIT ,"
+  "SC   ,OR   ,XOR  ,AND  ,EQ   ,NE   ,LT   ,GT   ,LE   ,GE   ,SHL  ,SHR  ,ADD  ,SUB  ,MUL  ,DIV  ,MOD  ,"
+  "ADDI ,MULI ,DIVI ,MODI ,DIVS ,MODS ,SHLI ,SHRI ,"
+  "EQBZ ,NEBZ ,LTBZ ,GTBZ ,LEBZ ,GEBZ ,EQBI ,NEBI ,LTBI ,GTBI ,LEBI ,GEBI ,";
 
 // types
 enum { CHAR, INT, PTR };
 
+// lexer character classes (identifier characters first)
+enum { Lid, Ldg, Lsk, Leof, Lnl, Lpp, Lsl, Lqt, Lop, Ltk };
+
+static char lcls[256]; // character class of each byte
+static int ltk[256];   // token for single character tokens
+
 // identifier offsets (since we can't create an ident struct)
-enum { Tk, Hash, Name, Class, Type, Val, HClass, HType, HVal, Idsz };
+// (Arg and End: a function's parameter count, and its final LEV if it can be inlined)
+enum { Tk, Hash, Name, Class, Type, Val, HClass, HType, HVal, Link, Arg, End, Idsz };
+
+// arenas: reserved address ranges the kernel commits page by page as they
+// are touched (by the program or by a system call writing into them), with an
+// untouchable guard chunk past the end they grow towards
+enum { ArBase, ArEnd, ArDown, ArName, ArMap, Arsz };
+
+#define ARCHUNK (2*1024*1024) // guard size and alignment
+#define NARENA 256            // arenas at a time, four to each compiler context
+
+static int arena[NARENA * Arsz], narena;
+
+// task stacks (spawn) come COBLK to a mapping, each with a guard page at its
+// bottom; they are a fixed size, as the VM stack holds pointers into itself
+#define COSTK (256*1024) // stack of a task
+#define COBLK 64         // task stacks mapped at a time
+#define NCOBLK 1024      // mappings segv() knows of
+
+static int coblk[NCOBLK], ncoblk; // their bases
+static pthread_mutex_t coblkm = PTHREAD_MUTEX_INITIALIZER;
+
+// reserve sz usable bytes; down arenas (the stack) grow from the top
+static char *reserve(int sz, char *name, int down, int huge)
+{
+  char *m;
+  int *a;
+
+  if (narena == NARENA ||
+      (m = mmap(0, sz + 2 * ARCHUNK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)) == MAP_FAILED) {
+    printf("could not reserve(%d) %s area\n", sz, name); exit(-1);
+  }
+  a = arena + narena++ * Arsz;
+  a[ArMap] = (int)m;
+  m = (char *)((int)m + ARCHUNK - 1 & -ARCHUNK);
+  if (huge) madvise(m, sz + ARCHUNK, MADV_HUGEPAGE);
+  a[ArBase] = (int)m; a[ArEnd] = (int)m + sz + ARCHUNK;
+  a[ArDown] = down; a[ArName] = (int)name;
+  if (mprotect(down ? m : (char *)a[ArEnd] - ARCHUNK, ARCHUNK, PROT_NONE)) { printf("could not guard %s area\n", name); exit(-1); }
+  return down ? (char *)a[ArEnd] : m;
+}
+
+// unmap the arena m points into
+static void unreserve(char *m)
+{
+  int *a, i;
+
+  i = 0;
+  while (i < narena) {
+    a = arena + i++ * Arsz;
+    if ((int)m >= a[ArBase] && (int)m <= a[ArEnd]) {
+      munmap((char *)a[ArMap], a[ArEnd] - a[ArBase] + ARCHUNK);
+      memcpy(a, arena + --narena * Arsz, Arsz * sizeof(int));
+      return;
+    }
+  }
+}
+
+// make m up to end read-only
+static void seal(char *m, char *end)
+{
+  if (end > m) mprotect(m, (end - m + 4095) & -4096, PROT_READ);
+}
+
+// SIGSEGV: report a hit on an arena's guard chunk or a task stack's guard
+// page. libc calls it back, so it takes real ints
+#undef int
+static void segv(int sig, siginfo_t *si, void *uc)
+{
+  long long *a, x, i;
+
+  x = (long long)si->si_addr;
+  i = 0;
+  while (i < ncoblk) {
+    if (x >= coblk[i] && x < coblk[i] + COBLK * COSTK && (x - coblk[i]) % COSTK < 4096) {
+      fflush(stdout);
+      write(1, "task stack area overflow\n", 25);
+      _exit(-1);
+    }
+    ++i;
+  }
+  i = 0;
+  while (i < narena) {
+    a = arena + i++ * Arsz;
+    if (a[ArDown] ? x >= a[ArBase] && x < a[ArBase] + ARCHUNK : x >= a[ArEnd] - ARCHUNK && x < a[ArEnd]) {
+      fflush(stdout);
+      write(1, (char *)a[ArName], strlen((char *)a[ArName]));
+      write(1, " area overflow\n", 15);
+      _exit(-1);
+    }
+  }
+  signal(SIGSEGV, SIG_DFL); // not a guard hit: crash as usual
+}
+#define int long long
+
+// compiler contexts (c4new): one program each, its symbol table, text, data
+// layout, rodata and compact code, so a process can hold any number of them.
+// The compiler works in the globals above: cxload() puts a context there and
+// cxsave() takes it back, and cxm keeps to one compile at a time. Instances of
+// a compiled program (vmnew) only read their context, so they need no lock
+enum { CxSym, CxSymh, CxSymhm, CxNsym, CxStrh, CxStrhm, CxNstr, CxText, CxE, CxData0, CxData, CxRo0, CxRo,
+       CxRsec, CxCtext, CxCmap, CxCstub, CxMain, CxPc, Cxsz };
+
+static int *cx; // the context in the globals
+static pthread_mutex_t cxm = PTHREAD_MUTEX_INITIALIZER;
+static jmp_buf cxerr; // where a syntax error leaves the compile
+
+static void symgrow()
+{
+  int *nh, i, *d, *n;
+
+  if (!(nh = malloc((symhm + 1) * 2 * sizeof(int)))) { printf("could not malloc symbol hash\n"); exit(-1); }
+  memset(nh, 0, (symhm + 1) * 2 * sizeof(int));
+  i = 0;
+  while (i <= symhm) { // relink every chain into the doubled bucket array
+    d = (int *)symh[i];
+    while (d) {
+      n = (int *)d[Link];
+      d[Link] = nh[(d[Hash] >> 6 ^ d[Hash]) & (symhm * 2 + 1)];
+      nh[(d[Hash] >> 6 ^ d[Hash]) & (symhm * 2 + 1)] = (int)d;
+      d = n;
+    }
+    ++i;
+  }
+  free(symh);
+  symh = nh;
+  symhm = symhm * 2 + 1;
+}
+
+// declare id as a local of type t at frame slot v, remembering what it shadows
+static void local(int t, int v)
+{
+  if (nscope == scopesz) {
+    scopesz = scopesz * 2 + 64;
+    if (!(scope = realloc(scope, scopesz * sizeof(int)))) { printf("could not realloc scope stack\n"); exit(-1); }
+  }
+  scope[nscope++] = (int)id;
+  id[HClass] = id[Class]; id[Class] = Loc;
+  id[HType]  = id[Type];  id[Type] = t;
+  id[HVal]   = id[Val];   id[Val] = v;
+}
+
+// sections an address operand can point into
+enum { RelNone, RelText, RelData, RelRo };
+
+// while compiling, an operand that is an address in text, data or rodata
+// carries its section in its top bits (real addresses stay below 2^47), so
+// folding and the optimizers move it along with the value. relocs() strips
+// the tags from the finished code and notes the sections in rsec
+#define TAG(s) ((0x5c40LL + (s)) << 48)
+
+static int sect(int v) { v = (v >> 48) - 0x5c40; return (v >= RelText && v <= RelRo) ? v : RelNone; }
+
+// print the source line just finished and the code emitted for it
+static void list()
+{
+  printf("%d: %.*s", line, p - lp, lp);
+  lp = p;
+  while (le < e) {
+    printf("%8.4s", &opname[*++le * 5]);
+    if (*le <= ADJ) { ++le; printf(" %d\n", *le - (sect(*le) ? TAG(sect(*le)) : 0)); } else printf("\n");
+  }
+}
+
+// find or add the identifier pp..p whose hash is in tk
+static void lookup(char *pp)
+{
+  ++nlook;
+  id = (int *)symh[(tk >> 6 ^ tk) & symhm];
+  while (id) {
+    ++nprobe;
+    if (tk == id[Hash] && !memcmp((char *)id[Name], pp, p - pp)) { tk = id[Tk]; return; }
+    id = (int *)id[Link];
+  }
+  id = sym; sym = sym + Idsz;
+  id[Name] = (int)pp;
+  id[Hash] = tk;
+  id[Link] = symh[(tk >> 6 ^ tk) & symhm];
+  symh[(tk >> 6 ^ tk) & symhm] = (int)id;
+  if (++nsym > symhm) symgrow();
+  tk = id[Tk] = Id;
+}
+
+// skip to the next newline or the end of the source, a word at a time while
+// at least eight bytes remain before pe
+static char *eol(char *s)
+{
+  unsigned long long w, v;
+
+  while (s + 8 <= pe) {
+    memcpy(&w, s, 8);
+    v = w ^ 0x0a0a0a0a0a0a0a0aULL;
+    if (((w - 0x0101010101010101ULL) & ~w | (v - 0x0101010101010101ULL) & ~v) & 0x8080808080808080ULL) break;
+    s = s + 8;
+  }
+  while (*s != 0 && *s != '\n') ++s;
+  return s;
+}
+
+// table driven lexer. Only blank runs and skipped lines go a word at a time:
+// an identifier's hash takes in every byte anyway, and numbers are short
+static void next()
+{
+  char *pp;
+  unsigned long long w;
+
+  while (1) {
+    switch (lcls[(unsigned char)(tk = *p++)]) {
+    case Lsk: // whitespace and characters c4 ignores; runs of blanks go eight at a time
+      while (p + 8 <= pe && (memcpy(&w, p, 8), w == 0x2020202020202020ULL)) p = p + 8;
+      while (lcls[(unsigned char)*p] == Lsk) ++p;
+      break;
+    case Leof:
+      --p; tk = 0;
+      return;
+    case Lnl:
+      if (src) list();
+      ++line;
+      break;
+    case Lpp:
+      p = eol(p);
+      break;
+    case Lid:
+      pp = p - 1;
+      while (lcls[(unsigned char)*p] <= Ldg) tk = tk * 147 + *p++;
+      tk = (tk << 6) + (p - pp);
+      lookup(pp);
+      return;
+    case Ldg:
+      if (ival = tk - '0') { while (lcls[(unsigned char)*p] == Ldg) ival = ival * 10 + *p++ - '0'; }
+      else if (*p == 'x' || *p == 'X') {
+        while ((tk = *++p) && ((tk >= '0' && tk <= '9') || (tk >= 'a' && tk <= 'f') || (tk >= 'A' && tk <= 'F')))
+          ival = ival * 16 + (tk & 15) + (tk >= 'A' ? 9 : 0);
+      }
+      else { while (*p >= '0' && *p <= '7') ival = ival * 8 + *p++ - '0'; }
+      tk = Num;
+      return;
+    case Lsl:
+      if (*p == '/') { p = eol(p + 1); break; }
+      tk = Div;
+      return;
+    case Lqt:
+      pp = rodata;
+      while (*p != 0 && *p != tk) {
+        if ((ival = *p++) == '\\') {
+          if ((ival = *p++) == 'n') ival = '\n';
+        }
+        if (tk == '"') *rodata++ = ival;
+      }
+      ++p;
+      if (tk == '"') ival = (int)pp; else tk = Num;
+      return;
+    case Lop:
+      if (tk == '=') { if (*p == '=') { ++p; tk = Eq; } else tk = Assign; }
+      else if (tk == '+') { if (*p == '+') { ++p; tk = Inc; } else tk = Add; }
+      else if (tk == '-') { if (*p == '-') { ++p; tk = Dec; } else tk = Sub; }
+      else if (tk == '!') { if (*p == '=') { ++p; tk = Ne; } }
+      else if (tk == '<') { if (*p == '=') { ++p; tk = Le; } else if (*p == '<') { ++p; tk = Shl; } else tk = Lt; }
+      else if (tk == '>') { if (*p == '=') { ++p; tk = Ge; } else if (*p == '>') { ++p; tk = Shr; } else tk = Gt; }
+      else if (tk == '|') { if (*p == '|') { ++p; tk = Lor; } else tk = Or; }
+      else if (tk == '&') { if (*p == '&') { ++p; tk = Lan; } else tk = And; }
+      return;
+    default: // single character token
+      tk = ltk[(unsigned char)tk];
+      return;
+    }
+  }
+}
 
-void next()
+// classic byte-at-a-time lexer, kept as the reference for the -l benchmark
+static void nextc()
 {
   char *pp;
 
   while (tk = *p) {
     ++p;
     if (tk == '\n') {
-      if (src) {
-        printf("%d: %.*s", line, p - lp, lp);
-        lp = p;
-        while (le < e) {
-          printf("%8.4s", &"LEA ,IMM ,JMP ,JSR ,BZ  ,BNZ ,ENT ,ADJ ,LEV ,LI  ,LC  ,SI  ,SC  ,PSH ,"
-                           "OR  ,XOR ,AND ,EQ  ,NE  ,LT  ,GT  ,LE  ,GE  ,SHL ,SHR ,ADD ,SUB ,MUL ,DIV ,MOD ,NOT,"
-                           "OPEN,READ,CLOS,PRTF,MALC,FREE,MSET,MCMP,EXIT,"[*++le * 5]);
-          if (*le <= ADJ) printf(" %d\n", *++le); else printf("\n");
-        }
-      }
+      if (src) list();
       ++line;
     }
     else if (tk == '#') {
@@ -74,14 +429,7 @@ void next()
       while ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_')
         tk = tk * 147 + *p++;
       tk = (tk << 6) + (p - pp);
-      id = sym;
-      while (id[Tk]) {
-        if (tk == id[Hash] && !memcmp((char *)id[Name], pp, p - pp)) { tk = id[Tk]; return; }
-        id = id + Idsz;
-      }
-      id[Name] = (int)pp;
-      id[Hash] = tk;
-      tk = id[Tk] = Id;
+      lookup(pp);
       return;
     }
     else if (tk >= '0' && tk <= '9') {
@@ -105,12 +453,12 @@ void next()
       }
     }
     else if (tk == '\'' || tk == '"') {
-      pp = data;
+      pp = rodata;
       while (*p != 0 && *p != tk) {
         if ((ival = *p++) == '\\') {
           if ((ival = *p++) == 'n') ival = '\n';
         }
-        if (tk == '"') *data++ = ival;
+        if (tk == '"') *rodata++ = ival;
       }
       ++p;
       if (tk == '"') ival = (int)pp; else tk = Num;
@@ -134,22 +482,395 @@ void next()
   } //removed ~ from last else if
 }
 
-void expr(int lev)
+static void lexinit()
+{
+  int c;
+
+  c = 0;
+  while (c < 256) { lcls[c] = Lsk; ltk[c] = c; ++c; }
+  c = 'a'; while (c <= 'z') lcls[c++] = Lid;
+  c = 'A'; while (c <= 'Z') lcls[c++] = Lid;
+  c = '0'; while (c <= '9') lcls[c++] = Ldg;
+  lcls['_'] = Lid;
+  lcls[0] = Leof; lcls['\n'] = Lnl; lcls['#'] = Lpp; lcls['/'] = Lsl;
+  lcls['\''] = Lqt; lcls['"'] = Lqt;
+  lcls['='] = lcls['+'] = lcls['-'] = lcls['!'] = lcls['<'] = lcls['>'] = lcls['|'] = lcls['&'] = Lop;
+  lcls['~'] = lcls['^'] = lcls['%'] = lcls['*'] = lcls['['] = lcls['?'] = Ltk;
+  lcls[';'] = lcls['{'] = lcls['}'] = lcls['('] = lcls[')'] = lcls[']'] = lcls[','] = lcls[':'] = Ltk;
+  ltk['~'] = Not; ltk['^'] = Xor; ltk['%'] = Mod; ltk['*'] = Mul; ltk['['] = Brak; ltk['?'] = Cond;
+}
+
+// -l: check that next() and nextc() agree on the source, then time both
+static int lexbench()
+{
+  char *s, *d;
+  int *tv, n, i, r, k, bad;
+  clock_t t0, tc, tt;
+
+  s = p; d = rodata;
+  if (!(tv = malloc((pe - s + 1) * 2 * sizeof(int)))) { printf("could not malloc token buffer\n"); return -1; }
+  n = 0; line = 1;
+  nextc();
+  while (tk) { // reference stream: token and its value
+    tv[n++] = tk;
+    tv[n++] = (tk == Num || tk == '"') ? ival : (tk == Id) ? (int)id : 0;
+    nextc();
+  }
+  p = s; rodata = d; line = 1; i = 0; bad = 0;
+  next();
+  while (tk && i < n) {
+    if (tv[i] != tk || tv[i + 1] != ((tk == Num || tk == '"') ? ival : (tk == Id) ? (int)id : 0)) { bad = 1; break; }
+    i = i + 2;
+    next();
+  }
+  if (bad || tk || i != n) { printf("lex: token streams differ at line %d (token %d)\n", line, i / 2); return -1; }
+  n = n / 2;
+
+  r = 4000000 / (pe - s + 1) + 1; // repeat small inputs to get measurable times
+  t0 = clock();
+  k = r; while (k--) { p = s; rodata = d; line = 1; nextc(); while (tk) nextc(); }
+  tc = clock() - t0 + 1;
+  t0 = clock();
+  k = r; while (k--) { p = s; rodata = d; line = 1; next(); while (tk) next(); }
+  tt = clock() - t0 + 1;
+  printf("lex: %d bytes, %d tokens, streams identical\n", (int)(pe - s), n);
+  printf("lex: classic %d Ktok/s, table %d Ktok/s, %d.%02dx\n",
+    (int)(n * r * (CLOCKS_PER_SEC / 1000) / tc), (int)(n * r * (CLOCKS_PER_SEC / 1000) / tt),
+    (int)(tc / tt), (int)(tc * 100 / tt % 100));
+  return 0;
+}
+
+static int fold(int op, int x, int y)
+{
+  if (op == OR)  return x | y;
+  if (op == XOR) return x ^ y;
+  if (op == AND) return x & y;
+  if (op == EQ)  return x == y;
+  if (op == NE)  return x != y;
+  if (op == LT)  return x < y;
+  if (op == GT)  return x > y;
+  if (op == LE)  return x <= y;
+  if (op == GE)  return x >= y;
+  if (op == SHL) return x << y;
+  if (op == SHR) return x >> y;
+  if (op == ADD) return x + y;
+  if (op == SUB) return x - y;
+  if (op == MUL) return x * y;
+  if (op == DIV) return x / y;
+  if (op == MOD) return x % y;
+  return ~x; // NOT
+}
+
+// can op be evaluated on constants x and y at compile time: not if it would
+// trap, nor if an address would lose its section or a number gain one
+static int foldable(int op, int x, int y)
+{
+  int s, t, r;
+
+  if ((op == DIV || op == MOD) && (!y || y == -1)) return 0;
+  if ((op == SHL || op == SHR) && (y < 0 || y >= 64)) return 0;
+  if (op < OR || op > NOT) return 0;
+  s = sect(x); t = sect(y); r = fold(op, x, y);
+  if (op == ADD && !(s && t)) return sect(r) == s + t;
+  if (op == SUB && (!t || t == s)) return sect(r) == (t ? RelNone : s);
+  if (op >= EQ && op <= GE && s == t) return 1;
+  return !s && !t && !sect(r);
+}
+
+// binary operator applied by an immediate opcode
+static int immop(int op)
+{
+  if (op == ADDI) return ADD;
+  if (op == MULI) return MUL;
+  if (op == DIVI) return DIV;
+  if (op == MODI) return MOD;
+  if (op == DIVS) return DIV;
+  if (op == MODS) return MOD;
+  if (op == SHLI) return SHL;
+  if (op == SHRI) return SHR;
+  return 0;
+}
+
+// the right operand of immediate opcode op with operand k
+static int immk(int op, int k) { return (op == DIVS || op == MODS) ? 1 << k : k; }
+
+// log2 of k if it is a power of two, else -1
+static int log2k(int k)
+{
+  int s;
+
+  if (k <= 0 || (k & (k - 1))) return -1;
+  s = 0; while (k > 1) { k = k >> 1; ++s; }
+  return s;
+}
+
+// emit op for the left operand coded in b+1..d and the right one in d+2..e
+// (d+1 holds the PSH): fold constant operands and use immediate forms
+static void arith(int op, int *b, int *d)
+{
+  int k, s;
+
+  if (e == d + 3 && d[2] == IMM) {
+    k = *e;
+    if (d == b + 2 && b[1] == IMM && foldable(op, b[2], k)) { b[2] = fold(op, b[2], k); e = b + 2; }
+    else if ((op == ADD || op == SUB || op == SHL || op == SHR || op == OR || op == XOR) && !k) e = d;
+    else if ((op == MUL || op == DIV) && k == 1) e = d;
+    else if (op == ADD || (op == SUB && !sect(k))) { e = d; *++e = ADDI; *++e = (op == ADD) ? k : -k; }
+    else if (op == MUL && (s = log2k(k)) > 0) { e = d; *++e = SHLI; *++e = s; }
+    else if (op == MUL) { e = d; *++e = MULI; *++e = k; }
+    else if ((op == DIV || op == MOD) && (s = log2k(k)) > 0) { e = d; *++e = (op == DIV) ? DIVS : MODS; *++e = s; }
+    else if ((op == DIV || op == MOD) && k && k != -1) { e = d; *++e = (op == DIV) ? DIVI : MODI; *++e = k; }
+    else if ((op == SHL || op == SHR) && k > 0 && k < 64) { e = d; *++e = (op == SHL) ? SHLI : SHRI; *++e = k; }
+    else *++e = op;
+    if (le > e) le = e;
+  }
+  else *++e = op;
+  if (op >= EQ && op <= GE && *e == op) { lcmp = e; lcmpb = b; }
+}
+
+// emit the branch taken when the condition coded in b+1..e is false and return
+// its operand; a compare that is the condition's outermost operator fuses with
+// the BZ (anything branching past the operand code lands on the compare)
+static int *bz(int *b)
 {
-  int t, *d;
+  if (lcmp == e && lcmpb == b) *e = *e - EQ + EQBZ; else *++e = BZ;
+  return ++e;
+}
+
+// the branch taken exactly when branch op o is not
+static int negbz(int o)
+{
+  if (o == BZ) return BNZ;
+  if (o == BNZ) return BZ;
+  return (o == EQBZ) ? NEBZ : (o == NEBZ) ? EQBZ : (o == LTBZ) ? GEBZ :
+         (o == GTBZ) ? LEBZ : (o == LEBZ) ? GTBZ : LTBZ;
+}
+
+// as bz(), for the branch taken when the condition is true
+static int *bnz(int *b)
+{
+  if (lcmp == e && lcmpb == b) *e = negbz(*e - EQ + EQBZ); else *++e = BNZ;
+  return ++e;
+}
+
+// point the jumps chained from operand j at t
+static void jpatch(int *j, int *t)
+{
+  int *n;
+
+  while (j) { n = (int *)*j; *j = (int)t; j = n; }
+}
+
+// join two jump chains
+static int *jcat(int *j, int *k)
+{
+  int *q;
+
+  if (!j) return k;
+  q = j; while (*q) q = (int *)*q;
+  *q = (int)k;
+  return j;
+}
+
+// a condition in parentheses is used for its value after all: join its jumps
+// with a as && and || leave it, the operand that decided (a compare fused
+// into a branch taken when true has left 0 in a, so those set 1 first)
+static void bval()
+{
+  int *d, *j, *n, *f;
+
+  f = 0; j = tj; tj = 0;
+  while (j) { n = (int *)*j; if (j[-1] == BNZ) { *j = (int)tj; tj = j; } else { *j = (int)f; f = j; } j = n; }
+  if (f) { *++e = JMP; d = ++e; jpatch(f, e + 1); *++e = IMM; *++e = 1; *d = (int)(e + 1); }
+  jpatch(tj, e + 1); jpatch(fj, e + 1); tj = fj = 0;
+}
+
+// emit a load of type t from the address in a
+static void load(int t)
+{
+  ld = e + 1;
+  *++e = (t == CHAR) ? LC : LI;
+}
+
+// the code ends in a load: leave the address in a instead and return the
+// load opcode, else 0
+static int unload()
+{
+  if (ld == e && (*e == LI || *e == LC)) return *e--;
+  if (ld == e - 1 && (*ld == LL || *ld == LG)) { *ld = (*ld == LL) ? LEA : IMM; return LI; }
+  return 0;
+}
+
+// scale the int operand in d+2..e to a pointer offset
+static void scale(int *d)
+{
+  if (e == d + 3 && d[2] == IMM && !sect(*e)) *e = *e * sizeof(int);
+  else { *++e = SHLI; *++e = log2k(sizeof(int)); }
+}
+
+// the function d whose code starts at f and ends in the LEV at z can be
+// inlined: it is small enough and does not call itself
+static void inlinable(int *d, int *f, int *z)
+{
+  int *q, n;
+
+  d[End] = 0;
+  if (!inl || *z != LEV) return;
+  q = f + 2; n = 0;
+  while (q < z) {
+    if ((*q == JSR || *q == JMP) && (int *)q[1] == f) return;
+    ++n; q = q + (*q <= ADJ ? 2 : 1);
+  }
+  if (n <= inl) d[End] = (int)z;
+}
+
+// where the copy of f's body starting at c puts its word t: each return
+// before it has grown into a JMP, and tail calls without arguments shrank
+static int *reloc(int *f, int *c, int *t)
+{
+  int *q;
+
+  q = f + 2;
+  while (q < t) {
+    if (*q == LEV) ++c;
+    else if (*q == TSR && !q[1]) c = c - 2;
+    q = q + (*q <= ADJ ? 2 : 1);
+  }
+  return c + (t - (f + 2));
+}
+
+// copy the body of the inlinable function d in place of a call whose
+// arguments were stored from frame slot o down: its parameters and then its
+// locals move to those slots, branches are relocated, returns jump past
+// the copy and tail calls return to it
+static void inlbody(int *d, int o)
+{
+  int *f, *q, *c, n;
+
+  f = (int *)d[Val]; q = f + 2; c = e + 1;
+  while (q < (int *)d[End]) {
+    *++e = *q;
+    if (*q == LEA || *q == LL || *q == SL) {
+      n = q[1]; *++e = o - ((n > 0) ? d[Arg] + 1 - n : d[Arg] - n - 1);
+      if (*q == LEA) ltaken = 1; // the caller's frame may escape
+    }
+    else if (*q == JMP || (*q >= BZ && *q <= GEBZ)) *++e = (int)reloc(f, c, (int *)q[1]);
+    else if (*q == LEV) { *e = JMP; *++e = 0; }
+    else if (*q == TSR) { // back to an ordinary call
+      *e = JSR; *++e = q[3];
+      if (q[1]) { *++e = ADJ; *++e = q[1]; }
+      q = q + 2;
+    }
+    else if (*q <= ADJ) *++e = q[1];
+    q = q + (*q <= ADJ ? 2 : 1);
+  }
+  if (e > c && e[-1] == JMP && !*e) e = e - 2; // a return at the end falls through
+  q = c;
+  while (q < e) {
+    if (*q == JMP && !q[1]) q[1] = (int)(e + 1);
+    q = q + (*q <= ADJ ? 2 : 1);
+  }
+  if (stats) printf("%d: inlined %.*s, %d words\n", line, d[Hash] & 63, (char *)d[Name], e + 1 - c);
+  ++ninl;
+}
+
+// a branch in b..e lands on t
+static int landed(int *b, int *t)
+{
+  while (b <= e) {
+    if ((*b == JMP || (*b >= BZ && *b <= GEBZ)) && (int *)b[1] == t) return 1;
+    b = b + (*b <= ADJ ? 2 : 1);
+  }
+  return 0;
+}
+
+// turn calls in b..e whose result is returned at once (JSR f; ADJ n; LEV)
+// into jumps that reuse the frame, unless a pointer into it may be live;
+// the callee's arguments must fit where this function's were passed, and
+// no other path may join at the ADJ or LEV (the end of a ?: arm)
+static void tails(int *b)
+{
+  int *q, f;
+
+  if (ltaken) return;
+  q = b;
+  while (q <= e) {
+    if (*q == JSR && q[2] == ADJ && q[3] < loc && q[4] == LEV && !landed(b, q + 2) && !landed(b, q + 4)) {
+      f = q[1]; *q = TSR; q[1] = q[3]; q[2] = JMP; q[3] = f; ++ntail;
+    }
+    q = q + (*q <= ADJ ? 2 : 1);
+  }
+}
+
+static int strhash(char *s, int n)
+{
+  int h;
+
+  h = 0;
+  while (n--) h = h * 147 + *s++;
+  return h ^ h >> 16;
+}
+
+// terminate the literal s..rodata and return the address of its one copy
+static int intern(char *s)
+{
+  int n, i, *q, *nh;
+
+  n = rodata - s;
+  *rodata++ = 0;
+  ++nlit;
+  i = strhash(s, n) & strhm;
+  while (strh[i * 2]) {
+    if (strh[i * 2 + 1] == n && !memcmp((char *)strh[i * 2], s, n)) { rodata = s; return strh[i * 2]; }
+    i = (i + 1) & strhm;
+  }
+  strh[i * 2] = (int)s; strh[i * 2 + 1] = n;
+  if (++nstr * 2 > strhm) { // keep the table at most half full
+    q = strh; n = strhm;
+    strhm = strhm * 2 + 1;
+    if (!(nh = malloc((strhm + 1) * 2 * sizeof(int)))) { printf("could not malloc literal table\n"); exit(-1); }
+    memset(nh, 0, (strhm + 1) * 2 * sizeof(int));
+    while (n >= 0) {
+      if (q[n * 2]) {
+        i = strhash((char *)q[n * 2], q[n * 2 + 1]) & strhm;
+        while (nh[i * 2]) i = (i + 1) & strhm;
+        nh[i * 2] = q[n * 2]; nh[i * 2 + 1] = q[n * 2 + 1];
+      }
+      --n;
+    }
+    free(q);
+    strh = nh;
+  }
+  return (int)s;
+}
+
+// IMM v for a literal; one that would pass for a tagged address is built at run time
+static void immlit(int v)
+{
+  if (!sect(v)) { *++e = IMM; *++e = v; return; }
+  *++e = IMM; *++e = v >> 8; *++e = SHLI; *++e = 8;
+  if (v & 255) { *++e = ADDI; *++e = v & 255; }
+}
+
+static void expr(int lev)
+{
+  int t, o, k, c, *d, *b, *l;
+
+  b = e; // this expression's code starts at b+1
+  c = bcx; bcx = 0; // a condition, its && and || chain only
 
-  if (!tk) { printf("%d: unexpected eof in expression\n", line); exit(-1); }
-  else if (tk == Num) { *++e = IMM; *++e = ival; next(); ty = INT; }
+  if (!tk) { printf("%d: unexpected eof in expression\n", line); longjmp(cxerr, 1); }
+  else if (tk == Num) { immlit(ival); next(); ty = INT; }
   else if (tk == '"') {
     *++e = IMM; *++e = ival; next();
     while (tk == '"') next();
-    data = (char *)((int)data + sizeof(int) & -sizeof(int)); ty = PTR;
+    *e = intern((char *)*e) + TAG(RelRo); ty = PTR;
   }
   else if (tk == Sizeof) {
-    next(); if (tk == '(') next(); else { printf("%d: open paren expected in sizeof\n", line); exit(-1); }
+    next(); if (tk == '(') next(); else { printf("%d: open paren expected in sizeof\n", line); longjmp(cxerr, 1); }
     ty = INT; if (tk == Int) next(); else if (tk == Char) { next(); ty = CHAR; }
     while (tk == Mul) { next(); ty = ty + PTR; }
-    if (tk == ')') next(); else { printf("%d: close paren expected in sizeof\n", line); exit(-1); }
+    if (tk == ')') next(); else { printf("%d: close paren expected in sizeof\n", line); longjmp(cxerr, 1); }
     *++e = IMM; *++e = (ty == CHAR) ? sizeof(char) : sizeof(int);
     ty = INT;
   }
@@ -158,20 +879,37 @@ void expr(int lev)
     if (tk == '(') {
       next();
       t = 0;
-      while (tk != ')') { expr(Assign); *++e = PSH; ++t; if (tk == ',') next(); }
-      next();
-      if (d[Class] == Sys) *++e = d[Val];
-      else if (d[Class] == Fun) { *++e = JSR; *++e = d[Val]; }
-      else { printf("%d: bad function call\n", line); exit(-1); }
-      if (t) { *++e = ADJ; *++e = t; }
+      if (d[Class] == Fun && d[End]) { // arguments go straight to the callee's slots
+        k = nin; o = -(nloc + k + 1);
+        nin = nin + d[Arg] + ((int *)d[Val])[1];
+        if (nloc + nin > *ent) *ent = nloc + nin;
+        while (tk != ')') { expr(Assign); if (t < d[Arg]) { *++e = SL; *++e = o - t; } ++t; if (tk == ',') next(); }
+        next();
+        inlbody(d, o);
+        nin = k;
+      }
+      else {
+        while (tk != ')') { expr(Assign); *++e = PSH; ++t; if (tk == ',') next(); }
+        next();
+        if (d[Class] == Sys) *++e = d[Val];
+        else if (d[Class] == Fun) { lcall = e + 1; *++e = JSR; *++e = d[Val]; }
+        else { printf("%d: bad function call\n", line); longjmp(cxerr, 1); }
+        if (t) { *++e = ADJ; *++e = t; }
+      }
       ty = d[Type];
     }
-    else if (d[Class] == Num) { *++e = IMM; *++e = d[Val]; ty = INT; }
+    else if (d[Class] == Num) { immlit(d[Val]); ty = INT; }
+    else if (d[Class] == Fun) { *++e = IMM; *++e = d[Val] + TAG(RelText); ty = INT; } // its address, for spawn()
+    else if (d[Class] != Loc && d[Class] != Glo) { printf("%d: undefined variable\n", line); longjmp(cxerr, 1); }
+    else if ((ty = d[Type]) != CHAR) { // int or pointer: fused load
+      ld = e + 1;
+      if (d[Class] == Loc) { *++e = LL; *++e = loc - d[Val]; }
+      else { *++e = LG; *++e = d[Val] + TAG(RelData); }
+    }
     else {
       if (d[Class] == Loc) { *++e = LEA; *++e = loc - d[Val]; }
-      else if (d[Class] == Glo) { *++e = IMM; *++e = d[Val]; }
-      else { printf("%d: undefined variable\n", line); exit(-1); }
-      *++e = ((ty = d[Type]) == CHAR) ? LC : LI;
+      else { *++e = IMM; *++e = d[Val] + TAG(RelData); }
+      load(ty);
     }
   }
   else if (tk == '(') {
@@ -179,200 +917,3099 @@ void expr(int lev)
     if (tk == Int || tk == Char) {
       t = (tk == Int) ? INT : CHAR; next();
       while (tk == Mul) { next(); t = t + PTR; }
-      if (tk == ')') next(); else { printf("%d: bad cast\n", line); exit(-1); }
+      if (tk == ')') next(); else { printf("%d: bad cast\n", line); longjmp(cxerr, 1); }
       expr(Inc);
       ty = t;
     }
     else {
+      if (c) { ccb = e; bcx = 1; } // (a || b) && c branches as if unparenthesized
       expr(Assign);
-      if (tk == ')') next(); else { printf("%d: close paren expected\n", line); exit(-1); }
+      if (tk == ')') next(); else { printf("%d: close paren expected\n", line); longjmp(cxerr, 1); }
+      if (c && (tj || fj) && tk != Lan && tk != Lor && tk != Cond && tk != ')') bval();
     }
   }
   else if (tk == Mul) {
     next(); expr(Inc);
-    if (ty > INT) ty = ty - PTR; else { printf("%d: bad dereference\n", line); exit(-1); }
-    *++e = (ty == CHAR) ? LC : LI;
+    if (ty > INT) ty = ty - PTR; else { printf("%d: bad dereference\n", line); longjmp(cxerr, 1); }
+    load(ty);
   }
   else if (tk == And) {
     next(); expr(Inc);
-    if (*e == LC || *e == LI) --e; else { printf("%d: bad address-of\n", line); exit(-1); }
+    if (!unload()) { printf("%d: bad address-of\n", line); longjmp(cxerr, 1); }
+    if (e[-1] == LEA) ltaken = 1;
     ty = ty + PTR;
   }
-  else if (tk == '!') { next(); expr(Inc); *++e = PSH; *++e = IMM; *++e = 0; *++e = EQ; ty = INT; }
+  else if (tk == '!') {
+    next(); expr(Inc);
+    if (e == b + 2 && b[1] == IMM) *e = !*e; else *++e = EQZ;
+    ty = INT;
+  }
   else if (tk == '~') { next(); expr(Inc); *++e = PSH; *++e = IMM; *++e = -1; *++e = XOR; ty = INT; }
   else if (tk == Add) { next(); expr(Inc); ty = INT; }
   else if (tk == Sub) {
-    next(); *++e = IMM;
-    if (tk == Num) { *++e = -ival; next(); } else { *++e = -1; *++e = PSH; expr(Inc); *++e = MUL; }
+    next(); expr(Inc);
+    if (e == b + 2 && b[1] == IMM && !sect(*e)) *e = -*e; else *++e = NEG;
     ty = INT;
   }
   else if (tk == Inc || tk == Dec) {
     t = tk; next(); expr(Inc);
-    if (*e == LC) { *e = PSH; *++e = LC; }
-    else if (*e == LI) { *e = PSH; *++e = LI; }
-    else { printf("%d: bad lvalue in pre-increment\n", line); exit(-1); }
-    *++e = PSH;
-    *++e = IMM; *++e = (ty > PTR) ? sizeof(int) : sizeof(char);
-    *++e = (t == Inc) ? ADD : SUB;
-    *++e = (ty == CHAR) ? SC : SI;
+    t = ((t == Inc) ? 1 : -1) * ((ty > PTR) ? (int)sizeof(int) : (int)sizeof(char));
+    if (ld == e - 1 && (*ld == LL || *ld == LG)) { *++e = ADDI; *++e = t; *++e = (*ld == LL) ? SL : SG; *++e = ld[1]; }
+    else if ((o = unload())) { *++e = PSH; *++e = o; *++e = ADDI; *++e = t; *++e = (o == LC) ? SC : SI; }
+    else { printf("%d: bad lvalue in pre-increment\n", line); longjmp(cxerr, 1); }
   }
-  else { printf("%d: bad expression\n", line); exit(-1); }
+  else { printf("%d: bad expression\n", line); longjmp(cxerr, 1); }
 
   while (tk >= lev) { // "precedence climbing" or "Top Down Operator Precedence" method
     t = ty;
     if (tk == Assign) {
       next();
-      if (*e == LC || *e == LI) *e = PSH; else { printf("%d: bad lvalue in assignment\n", line); exit(-1); }
-      expr(Assign); *++e = ((ty = t) == CHAR) ? SC : SI;
+      if (ld == e - 1 && (*ld == LL || *ld == LG)) { // value first, then store it directly
+        o = (*ld == LL) ? SL : SG; k = ld[1];
+        e = ld - 1; if (le > e) le = e;
+        expr(Assign); *++e = o; *++e = k;
+      }
+      else if (unload()) { *++e = PSH; expr(Assign); *++e = (t == CHAR) ? SC : SI; }
+      else { printf("%d: bad lvalue in assignment\n", line); longjmp(cxerr, 1); }
+      ty = t;
     }
     else if (tk == Cond) {
       next();
-      *++e = BZ; d = ++e;
+      if (c && (tj || fj)) { // a && b ? x : y tests a and b once
+        d = bz(ccb); *d = (int)fj; jpatch(tj, e + 1); tj = fj = 0; ccb = b;
+      }
+      else { d = bz(b); *d = 0; }
       expr(Assign);
-      if (tk == ':') next(); else { printf("%d: conditional missing colon\n", line); exit(-1); }
-      *d = (int)(e + 3); *++e = JMP; d = ++e;
+      if (tk == ':') next(); else { printf("%d: conditional missing colon\n", line); longjmp(cxerr, 1); }
+      jpatch(d, e + 3); *++e = JMP; d = ++e;
       expr(Cond);
       *d = (int)(e + 1);
     }
-    else if (tk == Lor) { next(); *++e = BNZ; d = ++e; expr(Lan); *d = (int)(e + 1); ty = INT; }
-    else if (tk == Lan) { next(); *++e = BZ;  d = ++e; expr(Or);  *d = (int)(e + 1); ty = INT; }
-    else if (tk == Or)  { next(); *++e = PSH; expr(Xor); *++e = OR;  ty = INT; }
-    else if (tk == Xor) { next(); *++e = PSH; expr(And); *++e = XOR; ty = INT; }
-    else if (tk == And) { next(); *++e = PSH; expr(Eq);  *++e = AND; ty = INT; }
-    else if (tk == Eq)  { next(); *++e = PSH; expr(Lt);  *++e = EQ;  ty = INT; }
-    else if (tk == Ne)  { next(); *++e = PSH; expr(Lt);  *++e = NE;  ty = INT; }
-    else if (tk == Lt)  { next(); *++e = PSH; expr(Shl); *++e = LT;  ty = INT; }
-    else if (tk == Gt)  { next(); *++e = PSH; expr(Shl); *++e = GT;  ty = INT; }
-    else if (tk == Le)  { next(); *++e = PSH; expr(Shl); *++e = LE;  ty = INT; }
-    else if (tk == Ge)  { next(); *++e = PSH; expr(Shl); *++e = GE;  ty = INT; }
-    else if (tk == Shl) { next(); *++e = PSH; expr(Add); *++e = SHL; ty = INT; }
-    else if (tk == Shr) { next(); *++e = PSH; expr(Add); *++e = SHR; ty = INT; }
+    else if (tk == Lor) {
+      next();
+      if (c) { l = bnz(ccb); *l = (int)tj; jpatch(fj, e + 1); tj = fj = 0; ccb = e; bcx = 1; }
+      else { *++e = BNZ; d = ++e; }
+      expr(Lan);
+      if (c) tj = jcat(tj, l); else *d = (int)(e + 1);
+      ty = INT;
+    }
+    else if (tk == Lan) {
+      next();
+      if (c) { l = bz(ccb); *l = (int)fj; jpatch(tj, e + 1); tj = fj = 0; ccb = e; bcx = 1; }
+      else d = bz(b);
+      expr(Or);
+      if (c) fj = jcat(fj, l); else *d = (int)(e + 1);
+      ty = INT;
+    }
+    else if (tk == Or)  { next(); d = e; *++e = PSH; expr(Xor); arith(OR, b, d);  ty = INT; }
+    else if (tk == Xor) { next(); d = e; *++e = PSH; expr(And); arith(XOR, b, d); ty = INT; }
+    else if (tk == And) { next(); d = e; *++e = PSH; expr(Eq);  arith(AND, b, d); ty = INT; }
+    else if (tk == Eq)  { next(); d = e; *++e = PSH; expr(Lt);  arith(EQ, b, d);  ty = INT; }
+    else if (tk == Ne)  { next(); d = e; *++e = PSH; expr(Lt);  arith(NE, b, d);  ty = INT; }
+    else if (tk == Lt)  { next(); d = e; *++e = PSH; expr(Shl); arith(LT, b, d);  ty = INT; }
+    else if (tk == Gt)  { next(); d = e; *++e = PSH; expr(Shl); arith(GT, b, d);  ty = INT; }
+    else if (tk == Le)  { next(); d = e; *++e = PSH; expr(Shl); arith(LE, b, d);  ty = INT; }
+    else if (tk == Ge)  { next(); d = e; *++e = PSH; expr(Shl); arith(GE, b, d);  ty = INT; }
+    else if (tk == Shl) { next(); d = e; *++e = PSH; expr(Add); arith(SHL, b, d); ty = INT; }
+    else if (tk == Shr) { next(); d = e; *++e = PSH; expr(Add); arith(SHR, b, d); ty = INT; }
     else if (tk == Add) {
-      next(); *++e = PSH; expr(Mul);
-      if ((ty = t) > PTR) { *++e = PSH; *++e = IMM; *++e = sizeof(int); *++e = MUL;  }
-      *++e = ADD;
+      next(); d = e; *++e = PSH; expr(Mul);
+      if ((ty = t) > PTR) scale(d);
+      arith(ADD, b, d);
     }
     else if (tk == Sub) {
-      next(); *++e = PSH; expr(Mul);
-      if (t > PTR && t == ty) { *++e = SUB; *++e = PSH; *++e = IMM; *++e = sizeof(int); *++e = DIV; ty = INT; }
-      else if ((ty = t) > PTR) { *++e = PSH; *++e = IMM; *++e = sizeof(int); *++e = MUL; *++e = SUB; }
-      else *++e = SUB;
-    }
-    else if (tk == Mul) { next(); *++e = PSH; expr(Inc); *++e = MUL; ty = INT; }
-    else if (tk == Div) { next(); *++e = PSH; expr(Inc); *++e = DIV; ty = INT; }
-    else if (tk == Mod) { next(); *++e = PSH; expr(Inc); *++e = MOD; ty = INT; }
-    else if (tk == Not) { next(); *++e = PSH; expr(Inc); *++e = NOT; ty = INT; }  // Added Bitwise NOT operator
+      next(); d = e; *++e = PSH; expr(Mul);
+      if (t > PTR && t == ty) { arith(SUB, b, d); *++e = SHRI; *++e = log2k(sizeof(int)); ty = INT; }
+      else if ((ty = t) > PTR) { scale(d); arith(SUB, b, d); }
+      else arith(SUB, b, d);
+    }
+    else if (tk == Mul) { next(); d = e; *++e = PSH; expr(Inc); arith(MUL, b, d); ty = INT; }
+    else if (tk == Div) { next(); d = e; *++e = PSH; expr(Inc); arith(DIV, b, d); ty = INT; }
+    else if (tk == Mod) { next(); d = e; *++e = PSH; expr(Inc); arith(MOD, b, d); ty = INT; }
+    else if (tk == Not) { next(); d = e; *++e = PSH; expr(Inc); arith(NOT, b, d); ty = INT; }  // Added Bitwise NOT operator
     else if (tk == Inc || tk == Dec) {
-      if (*e == LC) { *e = PSH; *++e = LC; }
-      else if (*e == LI) { *e = PSH; *++e = LI; }
-      else { printf("%d: bad lvalue in post-increment\n", line); exit(-1); }
-      *++e = PSH; *++e = IMM; *++e = (ty > PTR) ? sizeof(int) : sizeof(char);
-      *++e = (tk == Inc) ? ADD : SUB;
-      *++e = (ty == CHAR) ? SC : SI;
-      *++e = PSH; *++e = IMM; *++e = (ty > PTR) ? sizeof(int) : sizeof(char);
-      *++e = (tk == Inc) ? SUB : ADD;
+      t = ((tk == Inc) ? 1 : -1) * ((ty > PTR) ? (int)sizeof(int) : (int)sizeof(char));
+      if (ld == e - 1 && (*ld == LL || *ld == LG)) { *++e = ADDI; *++e = t; *++e = (*ld == LL) ? SL : SG; *++e = ld[1]; }
+      else if ((o = unload())) { *++e = PSH; *++e = o; *++e = ADDI; *++e = t; *++e = (o == LC) ? SC : SI; }
+      else { printf("%d: bad lvalue in post-increment\n", line); longjmp(cxerr, 1); }
+      *++e = ADDI; *++e = -t;
       next();
     }
     else if (tk == Brak) {
-      next(); *++e = PSH; expr(Assign);
-      if (tk == ']') next(); else { printf("%d: close bracket expected\n", line); exit(-1); }
-      if (t > PTR) { *++e = PSH; *++e = IMM; *++e = sizeof(int); *++e = MUL;  }
-      else if (t < PTR) { printf("%d: pointer type expected\n", line); exit(-1); }
-      *++e = ADD;
-      *++e = ((ty = t - PTR) == CHAR) ? LC : LI;
+      next(); d = e; *++e = PSH; expr(Assign);
+      if (tk == ']') next(); else { printf("%d: close bracket expected\n", line); longjmp(cxerr, 1); }
+      if (t > PTR) scale(d);
+      else if (t < PTR) { printf("%d: pointer type expected\n", line); longjmp(cxerr, 1); }
+      arith(ADD, b, d);
+      load(ty = t - PTR);
     }
-    else { printf("%d: compiler error tk=%d\n", line, tk); exit(-1); }
+    else { printf("%d: compiler error tk=%d\n", line, tk); longjmp(cxerr, 1); }
   }
 }
 
-void stmt()
+// compile the condition of an if or while straight into branches: && and ||
+// jump to the body or past it as soon as the outcome is known, and compares
+// fuse with the branch; returns the chain of jumps taken when the condition is
+// false, the last of them first
+static int *cond()
 {
-  int *a, *b;
+  int *f;
 
-  if (tk == If) {
-    next();
-    if (tk == '(') next(); else { printf("%d: open paren expected\n", line); exit(-1); }
-    expr(Assign);
-    if (tk == ')') next(); else { printf("%d: close paren expected\n", line); exit(-1); }
-    *++e = BZ; b = ++e;
-    stmt();
-    if (tk == Else) {
-      *b = (int)(e + 3); *++e = JMP; b = ++e;
-      next();
-      stmt();
+  tj = fj = 0; ccb = e; bcx = 1;
+  expr(Assign);
+  f = bz(ccb); *f = (int)fj;
+  jpatch(tj, e + 1);
+  return f;
+}
+
+// loop optimizer (-L): a while loop, parsed as
+//   a: cond; BZ x; body; JMP a; x:
+// is rebuilt as
+//   a: hoisted; [U: i + (n-1)*step < bound?; body * n; JMP U;] R: cond; BZ x; B: body; cond; BNZ B; x:
+// so each trip pays one test. Pure expressions of two or more instructions
+// that read only constants, locals not stored in the loop and never address-
+// taken, and globals (when nothing in the loop stores through a pointer or
+// calls) are computed once into frame slots below the locals. A loop whose
+// condition is i < bound with bound invariant and whose body ends in
+// i = i + step, its only store to i, also runs n bodies per test
+static int *wb, *wbd, *wx, *wmap, *wend, *wslot, *wlab, *wv, nwv, nwa, *wsi, *wss, *wse, nrot, nunr, nhoist;
+static int wtk[256], nwtk; // locals whose address the function body takes
+
+// lex ahead through the function body for &x: a pointer made on a later
+// trip of an enclosing loop can reach x in a loop compiled before it
+static void addrs()
+{
+  char *sp, *sr; int st, si, *sd, sl, ss, d, pt;
+
+  sp = p; sr = rodata; st = tk; si = ival; sd = id; sl = line; ss = src;
+  src = 0; nwtk = 0; d = 1; pt = 0;
+  while (d && tk) {
+    if (tk == '{') ++d;
+    else if (tk == '}') --d;
+    else if (tk == And && pt != Id && pt != Num && pt != ')' && pt != ']' && pt != Inc && pt != Dec) {
+      next(); while (tk == '(') next();
+      if (tk == Id && id[Class] == Loc) { if (nwtk < 256) wtk[nwtk] = loc - id[Val]; ++nwtk; }
+      continue;
     }
-    *b = (int)(e + 1);
+    pt = tk; next();
   }
-  else if (tk == While) {
-    next();
-    a = e + 1;
-    if (tk == '(') next(); else { printf("%d: open paren expected\n", line); exit(-1); }
-    expr(Assign);
-    if (tk == ')') next(); else { printf("%d: close paren expected\n", line); exit(-1); }
-    *++e = BZ; b = ++e;
-    stmt();
-    *++e = JMP; *++e = (int)a;
-    *b = (int)(e + 1);
+  p = sp; rodata = sr; tk = st; ival = si; id = sd; line = sl; src = ss;
+}
+
+// is local x address-taken or stored in the loop
+static int wvar(int x)
+{
+  int i;
+
+  if (nwtk > 256) return 1;
+  i = 0; while (i < nwv) if (wv[i++] == x) return 1;
+  return 0;
+}
+
+// the code s..t-1 computes an invariant value: hoist it if that saves work
+static void wrec(int inv, int *s, int *t)
+{
+  if (inv && s + (*s <= ADJ ? 2 : 1) < t) wend[s - wb] = (int)t;
+}
+
+// find the hoistable expressions in s..t-1 by running the stack code
+// symbolically: a and each pushed word are invariant or not, and where their
+// code starts (and, pushed, ends)
+static void wscan(int *s, int *t, int mem)
+{
+  int *q, *st, o, x, d, inv, j;
+
+  d = 0; inv = 0; st = s; q = s;
+  while (q < t) {
+    o = *q; x = q[1];
+    if (wlab[q - wb]) { // code before a label is not contiguous with what follows
+      j = 0; while (j < d) { wrec(wsi[j], (int *)wss[j], (int *)wse[j]); wsi[j++] = 0; }
+      wrec(inv, st, q); inv = 0;
+    }
+    if (o == IMM || o == LEA || (o == LL && !wvar(x)) || (o == LG && !mem)) { inv = 1; st = q; }
+    else if (o == LL || o == LG || o == JSR || (o >= OPEN && o <= EXIT)) inv = 0;
+    else if (o == PSH) { if (d == 1024) return; wsi[d] = inv; wss[d] = (int)st; wse[d++] = (int)q; inv = 0; }
+    else if ((o >= OR && o <= MOD) || o == NOT) {
+      if (!d) return;
+      --d;
+      if (wsi[d] && inv && o != DIV && o != MOD) st = (int *)wss[d];
+      else { wrec(wsi[d], (int *)wss[d], (int *)wse[d]); wrec(inv, st, q); inv = 0; }
+    }
+    else if ((o >= ADDI && o <= SHRI) || o == NEG || o == EQZ) ;
+    else if (o == SI || o == SC || (o >= EQBZ && o <= GEBZ)) {
+      if (!d) return;
+      --d; wrec(wsi[d], (int *)wss[d], (int *)wse[d]); wrec(inv, st, q); inv = 0;
+    }
+    else if (o == LI || o == LC || o == SL || o == SG || o == BZ || o == BNZ || o == JMP || o == LEV) { wrec(inv, st, q); inv = 0; }
+    else if (o == ADJ || o == TSR) {
+      if (d < x) return;
+      while (x--) { --d; wrec(wsi[d], (int *)wss[d], (int *)wse[d]); }
+      inv = 0;
+    }
+    else return;
+    q = q + (o <= ADJ ? 2 : 1);
+  }
+}
+
+// copy the loop code s..t-1 after e with hoisted expressions replaced by
+// their slots, and point the copy's branches into s..t at the copy; those
+// leaving the condition for the body wbd or the exit wx get 1 and 0 to patch
+static void wcopy(int *s, int *t)
+{
+  int *q, *c;
+
+  c = e + 1; q = s;
+  while (q < t) {
+    wmap[q - wb] = (int)(e + 1);
+    if (wend[q - wb]) { *++e = LL; *++e = wslot[q - wb]; q = (int *)wend[q - wb]; }
+    else { *++e = *q; if (*q <= ADJ) *++e = q[1]; q = q + (*q <= ADJ ? 2 : 1); }
+  }
+  wmap[t - wb] = (int)(e + 1);
+  q = c;
+  while (q <= e) {
+    if (*q == JMP || (*q >= BZ && *q <= GEBZ)) {
+      if ((int *)q[1] >= s && (int *)q[1] <= t) q[1] = wmap[(int *)q[1] - wb];
+      else if ((int *)q[1] == wx) q[1] = 0;
+      else if ((int *)q[1] == wbd) q[1] = 1;
+    }
+    q = q + (*q <= ADJ ? 2 : 1);
+  }
+}
+
+// a new frame slot for a loop temporary, below any the loop body may use
+static int wtemp()
+{
+  nloc = *ent = *ent + 1;
+  return -nloc;
+}
+
+// rebuild the while loop a..e whose exit branch is at bz
+static void loop(int *a, int *bz)
+{
+  int *q, *z, *n0, *u, *r, *g, *h, *inc, i, k, s, o, n, m, mem, nb, tu;
+
+  z = e - 1; // the JMP back, where the body ends
+  n = e - a + 2;
+  if (!(wmap = malloc(n * 4 * sizeof(int))) || !(wv = malloc((e - ent + 258) * sizeof(int))) ||
+      !(wsi = malloc(1024 * 3 * sizeof(int)))) {
+    printf("could not malloc loop buffers\n"); exit(-1);
+  }
+  wend = wmap + n; wslot = wend + n; wlab = wslot + n; wss = wsi + 1024; wse = wss + 1024;
+  memset(wend, 0, n * 3 * sizeof(int));
+  wb = a; wbd = bz + 2; wx = e + 1; mem = 0; nb = 0;
+  nwv = 0; while (nwv < nwtk && nwv < 256) { wv[nwv] = wtk[nwv]; ++nwv; }
+  q = ent - 1; // address-taken locals, some only in inlined code
+  while (q <= e) { if (*q == LEA) wv[nwv++] = q[1]; q = q + (*q <= ADJ ? 2 : 1); }
+  nwa = nwv;
+  q = a; // what the loop stores
+  while (q <= e) {
+    if (*q == SL) wv[nwv++] = q[1];
+    if (*q == SG || *q == SI || *q == SC || *q == JSR || *q == TSR || (*q >= OPEN && *q <= EXIT)) mem = 1;
+    if ((*q == JMP || (*q >= BZ && *q <= GEBZ)) && (int *)q[1] >= a && (int *)q[1] <= e) wlab[(int *)q[1] - a] = 1;
+    if (q > bz && q < z) ++nb;
+    q = q + (*q <= ADJ ? 2 : 1);
+  }
+  wscan(a, z, mem);
+
+  q = a; // one slot per distinct expression
+  while (q < z) {
+    if (wend[q - wb]) {
+      g = a;
+      while (g < q && !(wend[g - wb] && wend[g - wb] - (int)g == wend[q - wb] - (int)q &&
+                        !memcmp(g, q, wend[q - wb] - (int)q))) g = g + (*g <= ADJ ? 2 : 1);
+      if (g < q) wslot[q - wb] = wslot[g - wb]; else { wslot[q - wb] = wtemp(); ++nhoist; }
+    }
+    q = q + (*q <= ADJ ? 2 : 1);
+  }
+
+  // a counter loop: cond is LL i; PSH; bound and the body ends in i = i + step
+  o = *bz; i = a[1]; inc = 0; k = s = 0; m = 0;
+  if (*a == LL && a[2] == PSH && (o == LTBZ || o == LEBZ || o == GTBZ || o == GEBZ) &&
+      (wend[a + 3 - wb] == (int)bz || (bz == a + 5 && (a[3] == IMM || (a[3] == LG && !mem) || (a[3] == LL && !wvar(a[4])))))) {
+    q = z; if (q[-2] == ADDI) q = q - 2; // i++ leaves the old value in a
+    if (q[-2] == SL && q[-1] == i) {
+      if (q[-4] == ADDI && q[-6] == LL && q[-5] == i) { inc = q - 6; k = q[-3]; }
+      else if (q[-3] == ADD && q[-5] == LL && !wvar(q[-4]) && q[-4] != i && q[-6] == PSH && q[-8] == LL && q[-7] == i) {
+        inc = q - 8; s = q[-4];
+      }
+    }
+    q = bz + 2; while (q < inc) q = q + (*q <= ADJ ? 2 : 1); // on an instruction boundary
+    if (q != inc) inc = 0;
+    m = (nb <= 20) ? 4 : (nb <= 48) ? 2 : 0;
+    if (!inc || (k && (k > 0) != (o == LTBZ || o == LEBZ)) || (!k && o != LTBZ && o != LEBZ)) m = 0;
+    g = wv; while (g < wv + nwa) if (*g++ == i || nwtk > 256) m = 0;
+    q = a; while (q < z) { if (*q == SL && q[1] == i && q != inc + (s ? 6 : 4)) m = 0; q = q + (*q <= ADJ ? 2 : 1); }
+    if (inc) { q = inc + 1; while (q <= z) if (wlab[q++ - wb]) m = 0; }
+  }
+
+  n0 = e + 1;
+  q = a; // hoisted expressions
+  while (q < z) {
+    if (wend[q - wb]) {
+      g = a; while (g < q && !(wend[g - wb] && wslot[g - wb] == wslot[q - wb])) g = g + (*g <= ADJ ? 2 : 1);
+      if (g == q) {
+        memcpy(e + 1, q, (wend[q - wb] - (int)q)); e = e + (wend[q - wb] - (int)q) / sizeof(int);
+        *++e = SL; *++e = wslot[q - wb];
+      }
+    }
+    q = q + (*q <= ADJ ? 2 : 1);
+  }
+  g = h = 0;
+  if (m) { // n bodies per test of i + (n-1)*step
+    if (s) {
+      *++e = LL; *++e = s; *++e = PSH; *++e = IMM; *++e = 0; *++e = GTBZ; g = ++e; // step <= 0
+      tu = wtemp(); *++e = LL; *++e = s; *++e = MULI; *++e = m - 1; *++e = SL; *++e = tu;
+    }
+    u = e + 1;
+    *++e = LL; *++e = i;
+    if (s) { *++e = PSH; *++e = LL; *++e = tu; *++e = ADD; } else { *++e = ADDI; *++e = k * (m - 1); }
+    *++e = PSH;
+    wcopy(a + 3, bz);
+    *++e = o; h = ++e;
+    while (m--) wcopy(bz + 2, z);
+    *++e = JMP; *++e = (int)u;
+    ++nunr;
+  }
+  r = e + 1;
+  if (g) *g = (int)r;
+  if (h) *h = (int)r;
+  wcopy(a, bz); *++e = o; g = ++e;
+  u = e + 1;
+  wcopy(bz + 2, z);
+  wcopy(a, bz);
+  *++e = negbz(o);
+  *++e = (int)u;
+  *g = (int)(e + 1);
+  q = n0;
+  while (q <= e) {
+    if ((*q == JMP || (*q >= BZ && *q <= GEBZ)) && (!q[1] || q[1] == 1)) q[1] = q[1] ? (int)u : (int)(e + 1);
+    q = q + (*q <= ADJ ? 2 : 1);
+  }
+  ++nrot;
+
+  k = n0 - a; q = n0; // move the new loop down over the old one
+  while (q <= e) {
+    if ((*q == JMP || (*q >= BZ && *q <= GEBZ)) && (int *)q[1] >= n0 && (int *)q[1] <= e + 1) q[1] = q[1] - k * sizeof(int);
+    q = q + (*q <= ADJ ? 2 : 1);
+  }
+  memmove(a, n0, (e - n0 + 1) * sizeof(int));
+  e = e - k;
+  ld = lcmp = lcall = 0;
+  if (src) { printf("    -- loop\n"); le = a - 1; }
+  free(wmap); free(wv); free(wsi);
+}
+
+static void stmt()
+{
+  int *a, *b;
+
+  if (tk == If) {
+    next();
+    if (tk == '(') next(); else { printf("%d: open paren expected\n", line); longjmp(cxerr, 1); }
+    b = cond();
+    if (tk == ')') next(); else { printf("%d: close paren expected\n", line); longjmp(cxerr, 1); }
+    stmt();
+    if (tk == Else) {
+      jpatch(b, e + 3); *++e = JMP; b = ++e; *b = 0;
+      next();
+      stmt();
+    }
+    jpatch(b, e + 1);
+  }
+  else if (tk == While) {
+    next();
+    a = e + 1;
+    if (tk == '(') next(); else { printf("%d: open paren expected\n", line); longjmp(cxerr, 1); }
+    b = cond();
+    if (tk == ')') next(); else { printf("%d: close paren expected\n", line); longjmp(cxerr, 1); }
+    stmt();
+    *++e = JMP; *++e = (int)a;
+    jpatch(b, e + 1);
+    if (loopt) loop(a, b - 1);
   }
   else if (tk == Return) {
     next();
     if (tk != ';') expr(Assign);
+    if (lcall == e - 1) { *++e = ADJ; *++e = 0; } // a tail call: leave room for TSR n; JMP f
     *++e = LEV;
-    if (tk == ';') next(); else { printf("%d: semicolon expected\n", line); exit(-1); }
+    if (tk == ';') next(); else { printf("%d: semicolon expected\n", line); longjmp(cxerr, 1); }
+  }
+  else if (tk == '{') {
+    next();
+    while (tk != '}') stmt();
+    next();
+  }
+  else if (tk == ';') {
+    next();
+  }
+  else {
+    expr(Assign);
+    if (tk == ';') next(); else { printf("%d: semicolon expected\n", line); longjmp(cxerr, 1); }
+  }
+}
+
+// words of stack an instruction pops (negative: pushes), or 99 if it leaves the expression
+static int spop(int op, int arg)
+{
+  if (op == PSH) return -1;
+  if (op == ADJ) return arg;
+  if ((op >= OR && op <= NOT) || (op >= EQBZ && op <= GEBZ) || op == SI || op == SC) return 1;
+  if (op == JSR || op == TSR || op == ENT || op == LEV) return 99;
+  return 0;
+}
+
+// does op branch within the program
+static int isbr(int op) { return op == JMP || (op >= BZ && op <= GEBZ); }
+
+// peephole optimizer: one decoded function at a time, dead instructions have pop < 0
+static int *pop, *parg, *ptg, *plab, pn;
+
+static int pnext(int k) { ++k; while (k < pn && pop[k] < 0) ++k; return k; }
+static int plive(int k) { return (k < pn && pop[k] < 0) ? pnext(k) : k; }
+
+// is a overwritten before it is read when control reaches k
+static int adead(int k, int d)
+{
+  k = plive(k);
+  if (k >= pn || d > 8) return 0;
+  if (pop[k] == IMM || pop[k] == LEA || pop[k] == LL || pop[k] == LG || pop[k] == JSR) return 1;
+  if (pop[k] == JMP && ptg[k] >= 0) return adead(ptg[k], d + 1);
+  if (pop[k] == ADJ) return adead(pnext(k), d + 1);
+  return 0;
+}
+
+// retarget branch k to instruction t
+static void pjump(int k, int t)
+{
+  if (ptg[t] < 0 && pop[t] == JMP) { ptg[k] = -1; parg[k] = parg[t]; }
+  else { ptg[k] = t; ++plab[t]; }
+}
+
+// fold constants and stack shuffles, thread jumps and drop unreachable code in b..e
+static void peep(int *b)
+{
+  int *ix, *q, k, j, k1, k2, k3, o, ch, d;
+
+  pn = 0; q = b;
+  while (q <= e) { q = q + (*q <= ADJ ? 2 : 1); ++pn; }
+  if (!(pop = malloc((pn + 1) * 5 * sizeof(int))) || !(ix = malloc((e - b + 2) * sizeof(int)))) {
+    printf("could not malloc peephole buffers\n"); exit(-1);
+  }
+  parg = pop + pn + 1; ptg = parg + pn + 1; plab = ptg + pn + 1;
+  k = 0; q = b;
+  while (q <= e) {
+    ix[q - b] = k;
+    pop[k] = *q; parg[k] = (*q <= ADJ) ? q[1] : 0;
+    q = q + (*q <= ADJ ? 2 : 1); ++k;
+  }
+  pop[pn] = -1; plab[pn] = 0;
+  k = 0;
+  while (k < pn) { // branch targets inside the function become instruction indices
+    ptg[k] = -1;
+    if (isbr(pop[k]) && (q = (int *)parg[k]) > b && q <= e) ptg[k] = ix[q - b];
+    ++k;
+  }
+  npeep0 = npeep0 + pn;
+
+  ch = 1;
+  while (ch) {
+    ch = 0;
+    k = 0; while (k <= pn) plab[k++] = 0;
+    k = 0; while (k < pn) { if (pop[k] >= 0 && ptg[k] >= 0) ++plab[ptg[k] = plive(ptg[k])]; ++k; }
+    k = plive(0);
+    while (k < pn) {
+      k1 = pnext(k); k2 = pnext(k1); k3 = pnext(k2);
+      o = pop[k];
+      if (isbr(o) && ptg[k] >= 0) {
+        j = ptg[k];
+        if (j == k1) { pop[k] = (o > BNZ) ? o - EQBZ + EQ : -1; ch = 1; } // branch to the next instruction
+        else if (j != k && (pop[j] == JMP || (pop[j] == o && o <= BNZ) || (pop[j] == BZ && o > BNZ)) && (ptg[j] != j)) {
+          pjump(k, pop[j] == JMP && ptg[j] < 0 ? j : ptg[j]); ch = 1;
+        }
+        else if (((o == BZ || o > BNZ) && pop[j] == BNZ) || (o == BNZ && pop[j] == BZ)) { // a is known at j
+          if (pnext(j) != j) { pjump(k, pnext(j)); ch = 1; }
+        }
+        else if ((o == BZ || o == BNZ) && pop[k1] == JMP && !plab[k1] && j == k2) { // BZ L; JMP M; L:
+          pop[k] = (o == BZ) ? BNZ : BZ; parg[k] = parg[k1];
+          if (ptg[k1] >= 0) pjump(k, ptg[k1]); else ptg[k] = -1;
+          pop[k1] = -1; ch = 1;
+        }
+      }
+      if (pop[k] == JMP || pop[k] == LEV) { // unreachable until the next label
+        j = k1;
+        while (j < pn && !plab[j]) { pop[j] = -1; j = pnext(j); ch = 1; }
+      }
+      else if (o == IMM && pop[k1] == PSH && pop[k2] == IMM && !plab[k1] && !plab[k2] && !plab[k3] &&
+               foldable(pop[k3], parg[k], parg[k2])) {
+        parg[k] = fold(pop[k3], parg[k], parg[k2]);
+        pop[k1] = pop[k2] = pop[k3] = -1; ch = 1;
+      }
+      else if (o == PSH && pop[k1] == IMM && !plab[k1] && !plab[k2]) {
+        d = parg[k1];
+        if (pop[k2] == ADD || (pop[k2] == SUB && !sect(d))) { pop[k] = ADDI; parg[k] = (pop[k2] == ADD) ? d : -d; pop[k1] = pop[k2] = -1; ch = 1; }
+        else if (pop[k2] == EQ && !d) { pop[k] = EQZ; pop[k1] = pop[k2] = -1; ch = 1; }
+        else if ((!d && (pop[k2] == OR || pop[k2] == XOR || pop[k2] == SHL || pop[k2] == SHR)) ||
+                 (d == 1 && (pop[k2] == MUL || pop[k2] == DIV))) { pop[k] = pop[k1] = pop[k2] = -1; ch = 1; }
+      }
+      else if (o == ADDI && !parg[k]) { pop[k] = -1; ch = 1; }
+      else if ((o == ADDI || o == IMM) && pop[k1] == ADDI && !plab[k1] && foldable(ADD, parg[k], parg[k1])) { parg[k] = parg[k] + parg[k1]; pop[k1] = -1; ch = 1; }
+      else if (o == IMM && immop(pop[k1]) && !plab[k1] && foldable(immop(pop[k1]), parg[k], immk(pop[k1], parg[k1]))) {
+        parg[k] = fold(immop(pop[k1]), parg[k], immk(pop[k1], parg[k1])); pop[k1] = -1; ch = 1;
+      }
+      else if (o >= EQ && o <= GE && pop[k1] == BZ && !plab[k1]) { // compare and branch left unfused by the parser
+        pop[k] = o - EQ + EQBZ; parg[k] = parg[k1]; ptg[k] = ptg[k1]; pop[k1] = -1; ch = 1;
+      }
+      else if (o == IMM && (pop[k1] == NEG || pop[k1] == EQZ) && !plab[k1] && (pop[k1] == EQZ || !sect(parg[k]))) {
+        parg[k] = (pop[k1] == NEG) ? -parg[k] : !parg[k]; pop[k1] = -1; ch = 1;
+      }
+      else if (o == IMM && (pop[k1] == BZ || pop[k1] == BNZ) && !plab[k1]) { // constant condition
+        if ((pop[k1] == BZ) == !parg[k]) pop[k1] = JMP; else pop[k1] = -1;
+        ch = 1;
+      }
+      else if (o == EQZ && (pop[k1] == BZ || pop[k1] == BNZ) && !plab[k1] && ptg[k1] >= 0 &&
+               adead(ptg[k1], 0) && adead(k2, 0)) { // !x; BZ L -> x; BNZ L when nobody looks at a
+        pop[k1] = (pop[k1] == BZ) ? BNZ : BZ; pop[k] = -1; ch = 1;
+      }
+      else if (o == IMM && parg[k] == -1 && pop[k1] == PSH && !plab[k1]) { // IMM -1; PSH; x; MUL -> x; NEG
+        j = k2; d = 1;
+        while (j < pn && d > 0 && (o = spop(pop[j], parg[j])) < 99) {
+          if (d == 1 && o == 1) break;
+          d = d - o; j = pnext(j);
+        }
+        if (j < pn && d == 1 && pop[j] == MUL) { pop[j] = NEG; pop[k] = pop[k1] = -1; ch = 1; }
+      }
+      k = pnext(k);
+    }
+  }
+
+  q = b; k = 0; // compact, then point branches at the new addresses
+  while (k < pn) {
+    ix[k] = (int)q;
+    if (pop[k] >= 0) { q = q + (pop[k] <= ADJ ? 2 : 1); ++npeep1; }
+    ++k;
+  }
+  ix[pn] = (int)q;
+  k = pn; while (k--) if (pop[k] < 0) ix[k] = ix[k + 1];
+  q = b; k = 0;
+  while (k < pn) {
+    if (pop[k] >= 0) {
+      *q++ = pop[k];
+      if (pop[k] <= ADJ) *q++ = (ptg[k] >= 0) ? ix[ptg[k]] : parg[k];
+    }
+    ++k;
+  }
+  e = q - 1;
+  if (src) { printf("    -- peephole\n"); le = b - 1; }
+  free(pop); free(ix);
+}
+
+// register translation: each function's stack code is run symbolically.
+// Expression stack slot j (the accumulator is slot d, the depth) holds a
+// constant, a local's register, or the temporary register rtmp - i of a slot
+// i <= j (after PSH the accumulator still shares the pushed slot's value).
+// Slots are forced into their temporaries only at branches and labels, and
+// slots reading a local whose address is taken (LEA) are copied out before
+// anything can store through a pointer
+static int *rmap, *rlab, *rdep, *rcon, *rval, *rtk, nrtk, rtmp, rlo, *rlast;
+
+// words in register instruction op
+static int rlen(int op) { return (op < RJMP) ? 1 : (op < RMOV) ? 2 : (op < RSC) ? 3 : 4; }
+
+// is a read before it is overwritten when control reaches the stack code at q
+static int alive(int *q, int n)
+{
+  while (*q == ADJ) q = q + 2;
+  if (*q == IMM || *q == LEA || *q == LL || *q == LG || *q == JSR) return 0;
+  if (*q == JMP && n < 8) return alive((int *)q[1], n + 1);
+  return 1;
+}
+
+static int rtaken(int r)
+{
+  int i;
+
+  i = 0; while (i < nrtk) if (rtk[i++] == r) return 1;
+  return 0;
+}
+
+// make slot j's temporary the destination of the next instruction
+static int rdst(int j)
+{
+  if (rtmp - j < rlo) rlo = rtmp - j;
+  rcon[j] = 0;
+  return rval[j] = rtmp - j;
+}
+
+// move slot j into its temporary
+static void rfix(int j)
+{
+  int r;
+
+  r = rval[j];
+  if (rcon[j]) { *++re = RIMM; *++re = rdst(j); *++re = r; }
+  else if (r != rtmp - j) { *++re = RMOV; *++re = rdst(j); *++re = r; }
+  rlast = 0;
+}
+
+// register holding slot j
+static int rreg(int j)
+{
+  if (rcon[j]) rfix(j);
+  return rval[j];
+}
+
+// copy out slots 0..d that read address-taken locals
+static void rsync(int d)
+{
+  int j;
+
+  j = 0;
+  while (j <= d) { if (!rcon[j] && rval[j] > rtmp && rtaken(rval[j])) rfix(j); ++j; }
+}
+
+static void rout(int op, int j, int x)
+{
+  *++re = op; rlast = ++re; *re = rdst(j); *++re = x;
+}
+
+static void rout3(int op, int j, int x, int y)
+{
+  *++re = op; rlast = ++re; *re = rdst(j); *++re = x; *++re = y;
+}
+
+// flush slots 0..d-1 and, if a is live, d before a branch at depth d
+static void rbranch(int d, int live)
+{
+  int j;
+
+  j = 0; while (j < d) rfix(j++);
+  if (live) rfix(d);
+}
+
+// words o pops off the expression stack
+static int rpop(int o, int x)
+{
+  if ((o >= OR && o <= NOT) || o == SI || o == SC || (o >= EQBZ && o <= GEBZ)) return 1;
+  return (o == ADJ) ? x : 0;
+}
+
+// rdep: the stack depth plus one at each word of b..fe-1 control reaches
+// from the entry, 0 elsewhere. Followed along the branches rather than taken
+// from whichever branch was translated last: a label reached only from below
+// (a loop of an inlined body inside an operand) still gets its real depth
+static void rdepth(int *b, int *fe)
+{
+  int *q, *n, o, d, more;
+
+  rdep[b - text] = 1; more = 1;
+  while (more) {
+    more = 0; q = b;
+    while (q < fe) {
+      o = *q; n = q + (o <= ADJ ? 2 : 1);
+      if ((d = rdep[q - text])) {
+        d = d - rpop(o, q[1]) + (o == PSH);
+        if (d < 1) { printf("stack code underflows at %.4s\n", &opname[o * 5]); exit(-1); }
+        if (isbr(o) && (int *)q[1] > b && (int *)q[1] < fe && !rdep[(int *)q[1] - text]) { rdep[(int *)q[1] - text] = d; more = 1; }
+        if (o != JMP && o != TSR && o != LEV && n < fe && !rdep[n - text]) { rdep[n - text] = d; more = 1; }
+      }
+      q = n;
+    }
+  }
+}
+
+// translate the function whose stack code is b..fe-1
+static void rfun(int *b, int *fe)
+{
+  int *q, *n, *ent, o, x, d, j, k, dead, live;
+
+  nrtk = 0; q = b; // labels and address-taken locals
+  while (q < fe) {
+    if (isbr(*q) && (int *)q[1] > b && (int *)q[1] < fe) rlab[(int *)q[1] - text] = 1;
+    if (*q == LEA && !rtaken(q[1])) {
+      if (nrtk == 4096) { printf("too many address-taken locals\n"); exit(-1); }
+      rtk[nrtk++] = q[1];
+    }
+    q = q + (*q <= ADJ ? 2 : 1);
+  }
+  rdepth(b, fe);
+  d = dead = 0; rtmp = -1; rlo = 0; ent = 0; rlast = 0;
+  q = b;
+  while (q < fe) {
+    if (rlab[q - text]) { // control joins here: everything in its temporary
+      if (!dead) rbranch(d, alive(q, 0));
+      d = rdep[q - text] - 1; dead = d < 0; // dead: nothing branches here
+      j = 0; while (j <= d) { rcon[j] = 0; rval[j] = rtmp - j; ++j; }
+      rlast = 0;
+    }
+    rmap[q - text] = (int)(re + 1);
+    o = *q; x = q[1];
+    n = q + (o <= ADJ ? 2 : 1);
+    if (d > 1000) { printf("expression too deep for registers\n"); exit(-1); }
+    if (!dead && d < rpop(o, x)) { printf("stack underflow at %.4s\n", &opname[o * 5]); exit(-1); }
+    if (dead) q = n;
+    else if (o == ENT) { *++re = RENT; ent = ++re; rtmp = -(x + 1); rlo = -x; rval[0] = rtmp; rcon[0] = 0; }
+    else if (o == LEA) rout(RLEA, d, x);
+    else if (o == IMM) { rcon[d] = 1; rval[d] = x; }
+    else if (o == LL) { rcon[d] = 0; rval[d] = x; }
+    else if (o == LG) rout(RLG, d, x);
+    else if (o == SL) {
+      j = 0; while (j < d) { if (!rcon[j] && rval[j] == x) rfix(j); ++j; }
+      if (rlast && !rcon[d] && rval[d] == rtmp - d && *rlast == rval[d]) *rlast = x; // compute straight into x
+      else if (rcon[d]) { *++re = RIMM; *++re = x; *++re = rval[d]; }
+      else if (rval[d] != x) { *++re = RMOV; *++re = x; *++re = rval[d]; }
+      if (!rcon[d]) rval[d] = x;
+      rlast = 0;
+    }
+    else if (o == SG) { j = rreg(d); *++re = RSG; *++re = x; *++re = j; rlast = 0; }
+    else if (o == PSH) { ++d; rcon[d] = rcon[d - 1]; rval[d] = rval[d - 1]; } // a keeps the pushed value
+    else if (o >= OR && o <= MOD) {
+      if (rcon[d - 1] && rcon[d] && foldable(o, rval[d - 1], rval[d])) { --d; rval[d] = fold(o, rval[d], rval[d + 1]); }
+      else if (rcon[d] && (o == ADD || o == SUB)) { j = rreg(d - 1); --d; rout3(RADDI, d, j, (o == ADD) ? rval[d + 1] : -rval[d + 1]); }
+      else if (rcon[d] && (o == DIV || o == MOD) && (k = log2k(rval[d])) > 0) { j = rreg(d - 1); --d; rout3((o == DIV) ? RDIVS : RMODS, d, j, k); }
+      else if (rcon[d] && (o == MUL || o == SHL || o == SHR || ((o == DIV || o == MOD) && rval[d]))) {
+        j = rreg(d - 1); --d;
+        rout3((o == MUL) ? RMULI : (o == SHL) ? RSHLI : (o == SHR) ? RSHRI : (o == DIV) ? RDIVI : RMODI, d, j, rval[d + 1]);
+      }
+      else if (rcon[d - 1] && (o == ADD || o == MUL)) { j = rreg(d); --d; rout3((o == ADD) ? RADDI : RMULI, d, j, rval[d]); }
+      else { j = rreg(d - 1); k = rreg(d); --d; rout3(o - OR + ROR, d, j, k); }
+    }
+    else if (o == NOT) {
+      if (rcon[d - 1]) { --d; rval[d] = ~rval[d]; }
+      else { j = rreg(d - 1); --d; rout(RNOT, d, j); }
+    }
+    else if ((o == NEG || o == EQZ) && rcon[d]) rval[d] = (o == NEG) ? -rval[d] : !rval[d];
+    else if (o == NEG || o == EQZ) rout((o == NEG) ? RNEG : REQZ, d, rreg(d));
+    else if (o >= ADDI && o <= SHRI) {
+      if (rcon[d] && foldable(immop(o), rval[d], immk(o, x))) rval[d] = fold(immop(o), rval[d], immk(o, x));
+      else rout3(o - ADDI + RADDI, d, rreg(d), x);
+    }
+    else if (o == LI || o == LC) rout((o == LI) ? RLI : RLC, d, rreg(d));
+    else if (o == SI || o == SC) {
+      rsync(d);
+      j = rreg(d - 1); k = rreg(d); --d;
+      if (o == SC) rout3(RSC, d, j, k);
+      else {
+        *++re = RSI; *++re = j; *++re = k; rlast = 0;
+        if (k > rtmp) { rcon[d] = 0; rval[d] = k; }
+        else if (alive(n, 0)) rout(RMOV, d, k);
+        else rval[d] = rtmp - d;
+      }
+    }
+    else if (o == JSR || (o >= OPEN && o <= EXIT)) {
+      k = 0;
+      if (*n == ADJ && !rlab[n - text] && n[1] <= d) { k = n[1]; n = n + 2; } // not where a ?: arm joins
+      rsync(d);
+      j = d - k;
+      while (j < d) {
+        if (rcon[j]) { *++re = RPSHI; *++re = rval[j]; }
+        else { *++re = RPSH; *++re = rval[j]; }
+        ++j;
+      }
+      if (o == JSR) { *++re = RJSR; *++re = x; *++re = RRET; }
+      else *++re = o - OPEN + ROPEN;
+      *++re = k; d = d - k; rlast = ++re; *re = rdst(d);
+    }
+    else if (o == ADJ) d = d - x;
+    else if (o == TSR) {
+      rsync(d);
+      j = d - x;
+      while (j < d) {
+        if (rcon[j]) { *++re = RPSHI; *++re = rval[j]; }
+        else { *++re = RPSH; *++re = rval[j]; }
+        ++j;
+      }
+      *++re = RTSR; *++re = x; *++re = RJMP; *++re = n[1];
+      n = n + 2; dead = 1;
+    }
+    else if (o == LEV) { j = rreg(d); *++re = RLEV; *++re = j; dead = 1; }
+    else if (o == JMP) {
+      rbranch(d, alive((int *)x, 0));
+      *++re = RJMP; *++re = x; dead = 1;
+    }
+    else if (o == BZ || o == BNZ) {
+      rbranch(d, alive((int *)x, 0) || alive(n, 0));
+      j = rreg(d);
+      *++re = (o == BZ) ? RBZ : RBNZ; *++re = j; *++re = x;
+    }
+    else if (o >= EQBZ && o <= GEBZ) {
+      live = alive((int *)x, 0) || alive(n, 0);
+      j = 0; while (j < d - 1) rfix(j++);
+      if (live) {
+        j = rreg(d - 1); k = rreg(d); --d;
+        rout3(o - EQBZ + REQ, d, j, k);
+        *++re = RBZ; *++re = rval[d];
+      }
+      else if (rcon[d]) { j = rreg(d - 1); k = rval[d]; --d; *++re = o - EQBZ + REQBI; *++re = j; *++re = k; }
+      else { j = rreg(d - 1); k = rreg(d); --d; *++re = o - EQBZ + REQBZ; *++re = j; *++re = k; }
+      *++re = x; rlast = 0;
+    }
+    else { printf("no register form for %.4s\n", &opname[o * 5]); exit(-1); }
+    q = n;
+  }
+  if (ent) *ent = -rlo;
+}
+
+// translate the whole program; branch and call operands are remapped once
+// every function is in place
+static int regs()
+{
+  int *q, *fe, n;
+
+  n = e - text + 2;
+  if (!(rmap = malloc(n * 3 * sizeof(int))) || !(rcon = malloc(1024 * 2 * sizeof(int))) ||
+      !(rtk = malloc(4096 * sizeof(int)))) {
+    printf("could not malloc register translation buffers\n"); return -1;
+  }
+  rlab = rmap + n; rdep = rlab + n; rval = rcon + 1024;
+  memset(rlab, 0, n * 2 * sizeof(int));
+  re = rtext;
+  q = text + 1;
+  while (q <= e) {
+    fe = q + 2; while (fe <= e && *fe != ENT) fe = fe + (*fe <= ADJ ? 2 : 1);
+    rfun(q, fe);
+    q = fe;
+  }
+  q = rtext + 1;
+  while (q <= re) {
+    if (*q == RJMP || *q == RJSR) q[1] = rmap[(int *)q[1] - text];
+    else if (*q == RBZ || *q == RBNZ) q[2] = rmap[(int *)q[2] - text];
+    else if (*q >= REQBZ) q[3] = rmap[(int *)q[3] - text];
+    if (src) {
+      printf("%8.5s", &rname[*q * 6]);
+      n = 1; while (n < rlen(*q)) printf(" %d", q[n++]);
+      printf("\n");
+    }
+    q = q + rlen(*q);
+  }
+  *++re = RHALT; // main returns here
+  free(rcon); free(rtk);
+  return 0;
+}
+
+// optimizing middle end (-O2): a function's stack code is lifted, one region
+// (the code between two labels) at a time, into a DAG of value-numbered nodes
+// hanging off a list of roots, then lowered back to stack code. Locals carry
+// the node last stored into them (copy propagation), loads are numbered with
+// a memory version bumped by every store or call (so repeated a[i] reads and
+// address computations are shared), and stores to locals that are not read
+// again before being overwritten or returning are dropped. A node is lowered
+// where it was first computed; if it is used again it is kept in the local
+// it was stored to or in a new temporary below the function's locals. Words
+// still on the expression stack at a branch (a ?: or && inside an operand)
+// are pushed there and enter the next region as NSTK nodes, popped in place
+enum { Nop, Na, Nb, Nc, Nref, Nleft, Nhome, Nfl, Nmk, Nsz }; // node fields
+enum { Ffx = 1, Fev = 2, Fsave = 4, Fdead = 8 };          // Nfl: has effects, lowered, keep in a temporary, dead store
+enum { NACC = EXIT + 1, NSTK };                            // node ops: a live on entry, a word already pushed
+enum { Rexpr, Rout, Rbr, Rlev, Rpsh };                     // roots: evaluate for effects, leave in a, branch, return, push
+
+static int *nd, nn, nmax, *nh, nhm, *nargs, nna, *ro, nro, *iev, nev, *cur, *lver, *itk, slo, nslot,
+    mv, nver, irbad, la, lown, ihv, *lst, lsd, *ob, *ow, acc, tmp0, ntmp, maxtmp, ilo, ich,
+    nir0, nir1, nircse, nirdead;
+static int *iq, *ix, *irg, *irs, *irr, *irv, *irn, *ira, *irf, *ipos, *ilin, *ilv, *inp, *ipp, *ipb, *imv, *isnap, *irlo, *idep,
+    ini, inr;
+
+static int *nod(int x) { return nd + x * Nsz; }
+
+// i'th operand of node x that is itself a node
+static int kid(int x, int i)
+{
+  int *n, o;
+
+  n = nod(x); o = n[Nop];
+  if (o == JSR || o == TSR || (o >= OPEN && o <= EXIT)) return (i < n[Nc]) ? nargs[n[Nb] + i] : 0;
+  if ((o >= OR && o <= MOD) || o == SI || o == SC) return (i == 0) ? n[Na] : (i == 1) ? n[Nb] : 0;
+  if (o == SL || o == SG) return i ? 0 : n[Nb];
+  if ((o >= ADDI && o <= SHRI) || o == NOT || o == NEG || o == EQZ || o == LI || o == LC) return i ? 0 : n[Na];
+  return 0;
+}
+
+static int inode(int op, int a, int b, int c, int fl)
+{
+  int *n, i, k;
+
+  if (nn + 1 >= nmax) { irbad = 1; return 0; }
+  n = nod(++nn);
+  n[Nop] = op; n[Na] = a; n[Nb] = b; n[Nc] = c; n[Nref] = 0; n[Nfl] = fl; n[Nmk] = -1;
+  i = 0; while (k = kid(nn, i++)) { ++nod(k)[Nref]; n[Nfl] = n[Nfl] | (nod(k)[Nfl] & Ffx); }
+  return nn;
+}
+
+// hash slot of the node computing op over a, b and c, or the empty slot for it
+static int vslot(int op, int a, int b, int c)
+{
+  int *n, h, x;
+
+  h = ((op * 31 + a) * 31 + b) * 31 + c; h = (h ^ (h >> 17)) & nhm;
+  while (x = nh[h]) {
+    n = nod(x);
+    if (n[Nop] == op && n[Na] == a && n[Nb] == b && n[Nc] == c) return h;
+    h = (h + 1) & nhm;
+  }
+  return h;
+}
+
+// the node computing op over a, b and c, shared if one is already available
+static int vn(int op, int a, int b, int c)
+{
+  int h;
+
+  if (nh[h = vslot(op, a, b, c)]) {
+    if (op != IMM && op != LEA && op != LL && op != LG) ++nircse;
+    return nh[h];
+  }
+  return nh[h] = inode(op, a, b, c, 0);
+}
+
+static int isk(int x) { return nod(x)[Nop] == IMM; }
+static int kval(int x) { return nod(x)[Na]; }
+static int konst(int k) { return vn(IMM, k, 0, 0); }
+
+static int mkimm(int op, int l, int k)
+{
+  int *n;
+
+  if (isk(l) && foldable(immop(op), kval(l), immk(op, k))) return konst(fold(immop(op), kval(l), immk(op, k)));
+  if ((op == ADDI || op == SHLI || op == SHRI) && !k) return l;
+  if ((op == MULI || op == DIVI) && k == 1) return l;
+  n = nod(l);
+  if (op == ADDI && n[Nop] == ADDI && foldable(ADD, n[Nb], k)) return mkimm(ADDI, n[Na], n[Nb] + k);
+  return vn(op, l, k, 0);
+}
+
+static int isstk(int x) { return nod(x)[Nop] == NSTK; }
+
+static int mkbin(int op, int l, int r)
+{
+  int k, t;
+
+  if (isstk(l)) return inode(op, l, r, 0, 0); // the left operand is popped, so no immediate forms
+  if (isk(l) && isk(r) && foldable(op, kval(l), kval(r))) return konst(fold(op, kval(l), kval(r)));
+  if (isk(r)) {
+    k = kval(r);
+    if (op == ADD || (op == SUB && !sect(k))) return mkimm(ADDI, l, (op == ADD) ? k : -k);
+    if (op == MUL) return (log2k(k) >= 0) ? mkimm(SHLI, l, log2k(k)) : mkimm(MULI, l, k);
+    if ((op == DIV || op == MOD) && log2k(k) > 0) return mkimm((op == DIV) ? DIVS : MODS, l, log2k(k));
+    if ((op == DIV || op == MOD) && k > 0) return mkimm((op == DIV) ? DIVI : MODI, l, k);
+    if ((op == SHL || op == SHR) && k >= 0 && k < 64) return mkimm((op == SHL) ? SHLI : SHRI, l, k);
+  }
+  if (isk(l) && (op == ADD || op == MUL)) return mkbin(op, r, l);
+  if ((op == ADD || op == MUL || op == AND || op == OR || op == XOR || op == EQ || op == NE) &&
+      l > r && !((nod(l)[Nfl] | nod(r)[Nfl]) & Ffx)) { t = l; l = r; r = t; } // one order for commutative ops
+  return vn(op, l, r, 0);
+}
+
+static int mkun(int op, int l)
+{
+  if (isk(l) && (op == EQZ || !sect(kval(l)))) return konst((op == NEG) ? -kval(l) : (op == EQZ) ? !kval(l) : ~kval(l));
+  return vn(op, l, 0, 0);
+}
+
+static int islot(int n) { return n - slo; }
+
+static void iroot(int k, int x, int t, int op)
+{
+  ro[nro * 4] = k; ro[nro * 4 + 1] = x; ro[nro * 4 + 2] = t; ro[nro * 4 + 3] = op; ++nro;
+  if (x) ++nod(x)[Nref];
+}
+
+// x was computed before the branch into region r: make it and its operands
+// available there
+static void imark(int x, int r)
+{
+  int *n, i, k, h;
+
+  if (!x || (n = nod(x))[Nmk] == r) return;
+  n[Nmk] = r;
+  if (n[Nop] != SL && n[Nop] != SG && n[Nop] != SI && n[Nop] != SC && n[Nop] != JSR && n[Nop] != TSR && n[Nop] != NACC && n[Nop] != NSTK &&
+      n[Nop] != LL && n[Nop] != LG && // reloading is as cheap as keeping them
+      !(n[Nop] >= OPEN && n[Nop] <= EXIT) && !nh[h = vslot(n[Nop], n[Na], n[Nb], n[Nc])]) nh[h] = x;
+  i = 0; while (k = kid(x, i++)) imark(k, r);
+}
+
+// a gets x; the old value becomes a root if it was never used and has effects
+static void seta(int x)
+{
+  int i;
+
+  if (la && lown && (nod(la)[Nfl] & Ffx)) {
+    i = 0; while (i < lsd) if (!isstk(lst[i++])) irbad = 1; // would run before values still to be pushed
+    iroot(Rexpr, la, 0, 0);
+  }
+  la = x; lown = 1;
+}
+
+// push the expression stack for real before control leaves the region here
+static void iflush()
+{
+  int i;
+
+  i = 0;
+  while (i < lsd) {
+    if (!isstk(lst[i])) { iroot(Rpsh, lst[i], 0, 0); lst[i] = inode(NSTK, 0, 0, 0, Ffx); }
+    ++i;
+  }
+}
+
+// the expression stack depth on entry to region y is d
+static void idepth(int y, int d)
+{
+  if (idep[y] < 0) idep[y] = d;
+  else if (idep[y] != d) irbad = 1;
+}
+
+// value of local n
+static int rdloc(int n)
+{
+  int x, k;
+
+  if (x = cur[islot(n)]) return x;
+  k = nn;
+  x = cur[islot(n)] = vn(LL, n, lver[islot(n)], 0);
+  if (x > k) iev[nev++] = x; // a read of the slot itself
+  return x;
+}
+
+// memory may have changed: loads get a new version, address-taken locals are reread
+static void memw()
+{
+  int i;
+
+  ++mv;
+  i = 0; while (i < nslot) { if (itk[i]) { cur[i] = 0; lver[i] = ++nver; } ++i; }
+}
+
+// lowering: append to ob, tracking which node a holds
+static void ins(int op)
+{
+  int *n;
+
+  if (acc && op != PSH && op != SL && op != SG && op != SI && op != BZ && op != BNZ && op != JMP && op != ADJ) {
+    n = nod(acc); // a value live into the region is saved before anything overwrites it
+    if (n[Nop] == NACC && n[Nleft] > 0 && !n[Nhome]) { *++ow = SL; *++ow = n[Nhome] = tmp0 - ntmp++; }
+    acc = 0;
+  }
+  if (ow - ob > ini * 16) { irbad = 1; ow = ob; }
+  *++ow = op;
+}
+
+static void ins2(int op, int x) { ins(op); *++ow = x; }
+
+// a store to local n other than of node v (or any store, n == 0) is being
+// lowered: values still needed but about to be lost are marked to be saved
+// in a temporary and the function is lowered again
+static void iclob(int n, int v)
+{
+  int x, *m;
+
+  x = ilo;
+  while (x <= nn) {
+    m = nod(x);
+    if (x != v && (m[Nfl] & Fev) && m[Nleft] > 0 && !(m[Nfl] & Fsave) &&
+        ((n && m[Nhome] == n) || (!n && ((m[Nop] == LG && !m[Nhome]) || (m[Nhome] > tmp0 && itk[islot(m[Nhome])]))))) {
+      m[Nfl] = m[Nfl] | Fsave; ich = 1;
+    }
+    ++x;
+  }
+}
+
+// operand x is on the stack already and gets popped
+static void ipop(int x)
+{
+  int *n;
+
+  n = nod(x); --n[Nleft]; n[Nfl] = n[Nfl] | Fev;
+}
+
+static void ilower(int x)
+{
+  int *n, *v, o, i, k;
+
+  n = nod(x);
+  --n[Nleft];
+  if (acc == x) { n[Nfl] = n[Nfl] | Fev; return; }
+  if (n[Nhome]) { ins2(LL, n[Nhome]); n[Nfl] = n[Nfl] | Fev; acc = x; return; }
+  o = n[Nop];
+  if (o == IMM || o == LEA || o == LL || o == LG) ins2(o, n[Na]);
+  else if (o >= OR && o <= MOD) { if (!isstk(n[Na])) { ilower(n[Na]); ins(PSH); } ilower(n[Nb]); if (isstk(n[Na])) ipop(n[Na]); ins(o); }
+  else if (o == NOT) { if (isstk(n[Na])) ipop(n[Na]); else { ilower(n[Na]); ins(PSH); } ins(NOT); }
+  else if (o >= ADDI && o <= SHRI) { ilower(n[Na]); ins2(o, n[Nb]); }
+  else if (o == NEG || o == EQZ || o == LI || o == LC) { ilower(n[Na]); ins(o); }
+  else if (o == SL) {
+    k = ihv; ihv = (!(n[Nfl] & Fdead) && !itk[islot(n[Na])]) ? n[Nb] : 0; // stored, so no temporary
+    ilower(n[Nb]);
+    ihv = k;
+    if (!(n[Nfl] & Fdead)) {
+      iclob(n[Na], n[Nb]);
+      ins2(SL, n[Na]);
+      v = nod(n[Nb]);
+      if (!itk[islot(n[Na])]) { // keep the value in the local it was stored to
+        if (!n[Nhome] && !(n[Nfl] & Fsave)) n[Nhome] = n[Na];
+        if (!v[Nhome] && !(v[Nfl] & Fsave) && v[Nop] != IMM && v[Nop] != LEA) v[Nhome] = n[Na];
+      }
+    }
+  }
+  else if (o == SG) { ilower(n[Nb]); iclob(0, 0); ins2(SG, n[Na]); }
+  else if (o == SI || o == SC) { if (!isstk(n[Na])) { ilower(n[Na]); ins(PSH); } ilower(n[Nb]); if (isstk(n[Na])) ipop(n[Na]); iclob(0, 0); ins(o); }
+  else if (o == JSR || o == TSR || (o >= OPEN && o <= EXIT)) {
+    i = 0; while (i < n[Nc]) { if (!isstk(nargs[n[Nb] + i])) { ilower(nargs[n[Nb] + i]); ins(PSH); } ++i; }
+    i = 0; while (i < n[Nc]) { if (isstk(nargs[n[Nb] + i])) ipop(nargs[n[Nb] + i]); ++i; }
+    iclob(0, 0);
+    if (o == TSR) { ins2(TSR, n[Nc]); ins2(JMP, n[Na]); }
+    else if (o == JSR) ins2(JSR, n[Na]); else ins(o);
+    if (n[Nc] && o != TSR) ins2(ADJ, n[Nc]);
+  }
+  else { irbad = 1; return; } // a live on entry but no longer in a, or a pushed word out of order
+  n[Nfl] = n[Nfl] | Fev; acc = x;
+  k = n[Nop] == IMM || n[Nop] == LEA || n[Nop] == LL || n[Nop] == LG; // cheaper to compute again
+  if (n[Nleft] > 0 && !n[Nhome] && (!k || (n[Nfl] & Fsave)) && (x != ihv || (n[Nfl] & Fsave))) { ins2(SL, n[Nhome] = tmp0 - ntmp++); acc = x; }
+}
+
+// lower x and push it, unless it was pushed before the region began
+static void ipush(int x)
+{
+  if (isstk(x)) return;
+  ilower(x); ins(PSH);
+}
+
+// lower x for its effects only
+static void idrop(int x)
+{
+  int *n, o, i, k;
+
+  n = nod(x); o = n[Nop];
+  if (n[Nfl] & Fev) { --n[Nleft]; return; }
+  if (o == NSTK) { ipop(x); ins2(ADJ, 1); return; }
+  if (n[Nleft] > 1 || o == SG || o == SI || o == SC || o == JSR || o == TSR || (o >= OPEN && o <= EXIT) ||
+      (o == SL && !(n[Nfl] & Fdead))) { ilower(x); return; }
+  --n[Nleft];
+  i = 0; while (k = kid(x, i++)) idrop(k);
+}
+
+// lift region r into roots
+static void ilift(int r)
+{
+  int *q, o, x, y, k, i, dead;
+
+  irn[r] = irlo[r] = nn + 1; irr[r] = nro; irv[r] = nev;
+  memset(nh, 0, (nhm + 1) * sizeof(int));
+  i = 0; while (i < nslot) cur[i++] = 0;
+  if (ipp[r] >= 0) { // entered only from an earlier branch: start from what was known there
+    irlo[r] = irlo[ipp[r]]; mv = imv[r];
+    k = r; while ((y = ipp[k]) >= 0) { i = irr[y]; while (i <= ipb[k]) imark(ro[i++ * 4 + 1], r); k = y; }
+    i = 0;
+    while (i < nslot) {
+      lver[i] = isnap[(r * 2 + 1) * nslot + i];
+      if ((x = isnap[r * 2 * nslot + i]) && nod(x)[Nmk] == r && nod(x)[Nop] != LL && nod(x)[Nop] != LG) cur[i] = x;
+      ++i;
+    }
+  }
+  lsd = 0; la = lown = dead = 0;
+  if (r && idep[r] < 0) { irbad = 1; return; } // only reached from below
+  while (lsd < idep[r]) lst[lsd++] = inode(NSTK, 0, 0, 0, Ffx);
+  ira[r] = (r && alive((int *)iq[irs[r]], 0)) ? (la = inode(NACC, 0, 0, 0, 0)) : 0;
+  i = irs[r];
+  while (i < irs[r + 1] && !irbad) {
+    q = (int *)iq[i++]; o = *q; x = q[1];
+    if (dead) ;
+    else if (o == LEA || o == IMM) seta(vn(o, x, 0, 0));
+    else if (o == LL) seta(rdloc(x));
+    else if (o == LG) seta(vn(LG, x, mv, 0));
+    else if (o == SL && la) {
+      y = inode(SL, x, la, 0, Ffx);
+      if (itk[islot(x)]) memw();
+      cur[islot(x)] = la; lver[islot(x)] = ++nver; iev[nev++] = y;
+      la = y; lown = 1;
+    }
+    else if (o == SG && la) { y = inode(SG, x, la, 0, Ffx); memw(); la = y; lown = 1; }
+    else if (o == PSH && la) { lst[lsd++] = la; lown = 0; }
+    else if (o >= OR && o <= MOD && lsd && la) { la = mkbin(o, lst[--lsd], la); lown = 1; }
+    else if (o == NOT && lsd && la && !((nod(la)[Nfl] | nod(lst[lsd - 1])[Nfl]) & Ffx)) { la = mkun(NOT, lst[--lsd]); lown = 1; }
+    else if ((o == NEG || o == EQZ) && la) { la = mkun(o, la); lown = 1; }
+    else if (o >= ADDI && o <= SHRI && la) { la = mkimm(o, la, x); lown = 1; }
+    else if ((o == LI || o == LC) && la) { la = vn(o, la, mv, 0); lown = 1; }
+    else if ((o == SI || o == SC) && lsd && la) { y = inode(o, lst[--lsd], la, 0, Ffx); memw(); la = y; lown = 1; }
+    else if (o == JSR || (o >= OPEN && o <= EXIT)) {
+      k = 0;
+      if (i < irs[r + 1] && *(int *)iq[i] == ADJ) { k = ((int *)iq[i])[1]; ++i; }
+      if (lsd < k) { irbad = 1; return; }
+      lsd = lsd - k; y = 0; while (y < k) { nargs[nna + y] = lst[lsd + y]; ++y; }
+      y = inode(o, (o == JSR) ? x : 0, nna, k, Ffx); nna = nna + k;
+      memw();
+      seta(y);
+    }
+    else if (o == TSR && lsd >= x && i < irs[r + 1] && *(int *)iq[i] == JMP) {
+      lsd = lsd - x; y = 0; while (y < x) { nargs[nna + y] = lst[lsd + y]; ++y; }
+      seta(inode(TSR, ((int *)iq[i++])[1], nna, x, Ffx)); nna = nna + x;
+      seta(0); dead = 1;
+    }
+    else if (o == JMP || o == BZ || o == BNZ || (o >= EQBZ && o <= GEBZ)) {
+      if (x < iq[0] || x >= iq[ini] || (y = ix[(int *)x - (int *)iq[0]]) <= 0) { irbad = 1; return; }
+      y = irg[y - 1];
+      if (o >= EQBZ && o <= GEBZ && lsd && la) { la = mkbin(o - EQBZ + EQ, lst[--lsd], la); o = BZ; }
+      if ((o != JMP && !la) || (o >= EQBZ && o <= GEBZ)) { irbad = 1; return; }
+      iflush(); idepth(y, lsd);
+      if (o == JMP && alive((int *)x, 0)) { if (!la) { irbad = 1; return; } iroot(Rout, la, 0, 0); }
+      else if (o == JMP) seta(0);
+      k = i; while (k < irs[y] && !(isbr(*(int *)iq[k]) && ((int *)iq[k])[1] < (int)q)) ++k;
+      if (inp[y] == 1 && y > r && k == irs[y]) { // the only way into region y, and not a loop exit
+        ipp[y] = r; ipb[y] = nro; imv[y] = mv;
+        k = 0; while (k < nslot) { isnap[y * 2 * nslot + k] = cur[k]; isnap[(y * 2 + 1) * nslot + k] = lver[k]; ++k; }
+      }
+      iroot(Rbr, (o == JMP) ? 0 : la, x, o); lown = 0;
+      iev[nev++] = -(y + 1);
+      dead = (o == JMP);
+    }
+    else if (o == LEV) { iroot(Rlev, la, 0, 0); dead = 1; }
+    else irbad = 1;
+  }
+  irf[r] = !dead;
+  if (!dead && !irbad) {
+    iflush();
+    if (irs[r + 1] == ini) irbad = 1;
+    else if (alive((int *)iq[irs[r + 1]], 0)) { if (la) iroot(Rout, la, 0, 0); else irbad = 1; }
+    else seta(0);
+    if (r + 1 < inr) idepth(r + 1, lsd);
+  }
+}
+
+// locals live on entry to region r, into ilv; with mark set, stores to
+// locals that are dead at that point are marked
+static void ilive(int r, int mark)
+{
+  int i, k, x, *n;
+
+  i = 0; while (i < nslot) { ilv[i] = (irf[r] && r + 1 < inr) ? ilin[(r + 1) * nslot + i] : 0; ++i; }
+  k = irv[r + 1];
+  while (k > irv[r]) {
+    x = iev[--k];
+    if (x < 0) { i = 0; while (i < nslot) { ilv[i] = ilv[i] | ilin[(-x - 1) * nslot + i]; ++i; } }
+    else {
+      n = nod(x); i = islot(n[Na]);
+      if (n[Nop] == LL) ilv[i] = 1;
+      else {
+        if (mark && !ilv[i] && !itk[i]) { n[Nfl] = n[Nfl] | Fdead; ++nirdead; }
+        ilv[i] = 0;
+      }
+    }
+  }
+}
+
+// lower every region's roots into ob
+static void iemit()
+{
+  int *n, r, k, x, t, o;
+
+  ow = ob; ntmp = 0;
+  x = 1;
+  while (x <= nn) {
+    n = nod(x++);
+    n[Nleft] = n[Nref]; n[Nfl] = n[Nfl] & ~Fev;
+    n[Nhome] = (n[Nop] == LL && !(n[Nfl] & Fsave)) ? n[Na] : 0;
+  }
+  acc = 0; ins2(ENT, 0);
+  r = 0;
+  while (r < inr && !irbad) {
+    ipos[r] = ow + 1 - ob; acc = ira[r]; ilo = irlo[r];
+    k = irr[r];
+    while (k < irr[r + 1] && !irbad) {
+      x = ro[k * 4 + 1]; t = ro[k * 4 + 2]; o = ro[k * 4 + 3];
+      if (ro[k * 4] == Rexpr) idrop(x);
+      else if (ro[k * 4] == Rout) ilower(x);
+      else if (ro[k * 4] == Rlev) { if (x) ilower(x); ins(LEV); }
+      else if (ro[k * 4] == Rpsh) { ilower(x); ins(PSH); }
+      else if (o == JMP) ins2(JMP, t);
+      else {
+        n = nod(x);
+        if (o == BZ && n[Nop] >= EQ && n[Nop] <= GE && n[Nleft] == 1 && !(n[Nfl] & Fev) && acc != x) {
+          --n[Nleft]; ipush(n[Na]); ilower(n[Nb]); if (isstk(n[Na])) ipop(n[Na]); ins2(n[Nop] - EQ + EQBZ, t);
+          n[Nfl] = n[Nfl] | Fev; acc = x;
+        }
+        else { ilower(x); ins2(o, t); }
+      }
+      ++k;
+    }
+    ++r;
+  }
+  if (ntmp > maxtmp) maxtmp = ntmp;
+}
+
+// run the middle end over the function whose stack code is b..e
+static void ir(int *b)
+{
+  int *q, i, k, r, pass, lo, hi;
+
+  ini = 0; q = b;
+  while (q <= e) { q = q + (*q <= ADJ ? 2 : 1); ++ini; }
+  nmax = 2 * ini + 16; nhm = 1; while (nhm < 2 * nmax) nhm = nhm * 2 + 1;
+  if (!(iq = malloc((ini + 1) * 16 * sizeof(int))) || !(ix = malloc((e - b + 2) * sizeof(int))) ||
+      !(nd = malloc(nmax * Nsz * sizeof(int))) || !(nh = malloc((nhm + 1) * sizeof(int))) ||
+      !(ro = malloc((4 * ini + 8) * 6 * sizeof(int))) || !(ob = malloc((ini * 16 + 64) * sizeof(int)))) {
+    printf("could not malloc middle end buffers\n"); exit(-1);
+  }
+  irg = iq + ini + 1; irs = irg + ini + 1; irr = irs + ini + 1; irv = irr + ini + 1; irn = irv + ini + 1;
+  ira = irn + ini + 1; irf = ira + ini + 1; ipos = irf + ini + 1; lst = ipos + ini + 1;
+  inp = lst + ini + 1; ipp = inp + ini + 1; ipb = ipp + ini + 1; imv = ipb + ini + 1; irlo = imv + ini + 1;
+  idep = irlo + ini + 1;
+  iev = ro + (4 * ini + 8) * 4; nargs = iev + ini + 8;
+
+  memset(ix, 0, (e - b + 2) * sizeof(int));
+  lo = -b[1]; hi = 0; k = 0; q = b; // instructions, and the range of local slots
+  while (q <= e) {
+    iq[k] = (int)q; ix[q - b] = ++k;
+    if ((*q == LL || *q == SL || *q == LEA) && q[1] < lo) lo = q[1];
+    if ((*q == LL || *q == SL || *q == LEA) && q[1] > hi) hi = q[1];
+    q = q + (*q <= ADJ ? 2 : 1);
+  }
+  iq[ini] = (int)(e + 1);
+  slo = lo; nslot = hi - lo + 1;
+  i = 0; while (i < ini) irg[i++] = 0;
+  i = 0; // regions start after ENT and at every branch target
+  while (i < ini) {
+    q = (int *)iq[i++];
+    if (isbr(*q) && (int *)q[1] > b && (int *)q[1] <= e && (k = ix[(int *)q[1] - b])) irg[k - 1] = 1;
+  }
+  inr = 0; i = 1;
+  while (i < ini) { if (i == 1 || irg[i]) irs[inr++] = i; irg[i++] = inr - 1; }
+  irs[inr] = ini;
+  r = 0; while (r < inr) { ipp[r] = idep[r] = -1; inp[r] = (r && *(int *)iq[irs[r] - 1] != JMP && *(int *)iq[irs[r] - 1] != LEV); ++r; }
+  i = 0;
+  while (i < ini) {
+    q = (int *)iq[i++];
+    if (isbr(*q) && (int *)q[1] > b && (int *)q[1] <= e && (k = ix[(int *)q[1] - b])) ++inp[irg[k - 1]];
+  }
+  if (!(cur = malloc((nslot * (inr * 3 + 4)) * sizeof(int)))) { printf("could not malloc middle end buffers\n"); exit(-1); }
+  lver = cur + nslot; itk = lver + nslot; ilv = itk + nslot; ilin = ilv + nslot; isnap = ilin + inr * nslot;
+  i = 0; while (i < nslot) { lver[i] = itk[i] = 0; ++i; }
+  i = 0; while (i < ini) { q = (int *)iq[i++]; if (*q == LEA) itk[islot(q[1])] = 1; }
+
+  nn = nna = nro = nev = irbad = 0; mv = nver = 0;
+  r = 0; while (r < inr && !irbad) ilift(r++);
+  irr[inr] = nro; irv[inr] = nev;
+
+  if (!irbad) { // liveness of locals across regions, then dead stores
+    memset(ilin, 0, inr * nslot * sizeof(int));
+    k = 1;
+    while (k) {
+      k = 0; r = inr;
+      while (r--) {
+        ilive(r, 0);
+        i = 0; while (i < nslot) { if (ilv[i] != ilin[r * nslot + i]) { ilin[r * nslot + i] = ilv[i]; k = 1; } ++i; }
+      }
+    }
+    r = 0; while (r < inr) ilive(r++, 1);
+  }
+
+  tmp0 = -b[1] - 1; maxtmp = 0; pass = 0;
+  ich = 1;
+  while (ich && !irbad) {
+    ich = 0; iemit();
+    if (++pass > 8) irbad = 1;
+  }
+  if (!irbad && ow - ob <= e - b + 1) {
+    ob[2] = b[1] + maxtmp;
+    q = ob + 1; // branches point at the new region starts
+    while (q <= ow) {
+      if (isbr(*q) && (int *)q[1] > b && (int *)q[1] <= e) q[1] = (int)(b + ipos[irg[ix[(int *)q[1] - b] - 1]] - 1);
+      q = q + (*q <= ADJ ? 2 : 1);
+    }
+    nir0 = nir0 + ini;
+    q = ob + 1; while (q <= ow) { ++nir1; q = q + (*q <= ADJ ? 2 : 1); }
+    memcpy(b, ob + 1, (ow - ob) * sizeof(int));
+    e = b + (ow - ob) - 1;
+    if (src) { printf("    -- ir\n"); le = b - 1; }
+  }
+  else { nir0 = nir0 + ini; nir1 = nir1 + ini; }
+  free(iq); free(ix); free(nd); free(nh); free(ro); free(ob); free(cur);
+}
+
+// strip the section tags from the finished text, noting in rsec which
+// operands are addresses and where into (branch targets are in the text)
+static void relocs()
+{
+  int *q, s;
+
+  if (!(rsec = malloc((e - text + 2) * sizeof(int)))) { printf("could not malloc relocations\n"); exit(-1); }
+  memset(rsec, 0, (e - text + 2) * sizeof(int));
+  q = text + 1;
+  while (q <= e) {
+    if (*q <= ADJ) {
+      if (*q >= JMP && *q <= GEBZ) rsec[q + 1 - text] = RelText;
+      else if (s = sect(q[1])) { q[1] = q[1] - TAG(s); rsec[q + 1 - text] = s; }
+      q = q + 2;
+    }
+    else ++q;
+  }
+}
+
+// map the source read-only, or read it in growing chunks when it cannot be
+// mapped (pipes, terminals); either way a NUL byte follows p..pe
+static int source(int fd)
+{
+  struct stat st;
+  char *m;
+  int n, i, sz;
+
+  if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+    i = sysconf(_SC_PAGESIZE);
+    sz = (st.st_size + i) & -i; // room for at least one zero byte past the end
+    if ((m = mmap(0, sz, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED ||
+        mmap(m, st.st_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      printf("could not mmap(%d) source\n", (int)st.st_size); return -1;
+    }
+    madvise(m, st.st_size, MADV_SEQUENTIAL);
+    lp = p = m; pe = m + st.st_size;
+    return st.st_size;
+  }
+  sz = 64*1024; n = 0; m = 0;
+  while (1) {
+    if (!(m = realloc(m, sz))) { printf("could not realloc(%d) source area\n", sz); return -1; }
+    if ((i = read(fd, m + n, sz - n - 1)) < 0) { printf("read() returned %d\n", i); return -1; }
+    if (!i) break;
+    if ((n = n + i) == sz - 1) sz = sz * 2;
+  }
+  if (!n) { printf("read() returned 0\n"); return -1; }
+  m[n] = 0;
+  lp = p = m; pe = m + n;
+  return n;
+}
+
+// -o: the runtime an executable carries, compiled with the program. Only
+// read, write and malloc (there a bump of the break) are system calls in
+// it; output is held in __ob until full, the program exits or, on a
+// terminal (__tty, set by the entry code), the end of each printf
+static char *rtsrc =
+  "char *__ob, *__nb, *__ib; int __on, __ot, *__fl, __tty, __ip, __in;\n"
+  "void __flush() { if (__on) { write(1, __ob, __on); __on = 0; } }\n"
+  "void __iflush() { if (__tty) __flush(); }\n"
+  "void __put(int c) { if (__on == 65536) __flush(); __ob[__on++] = c; ++__ot; }\n"
+  "void __pad(int n, int c) { while (n-- > 0) __put(c); }\n"
+  "int __printf(int *t)\n"
+  "{\n"
+  "  char *f, *s, *d; int left, zero, sg, w, pr, l, c, x, n, b, k;\n"
+  "  if (!__ob) { __ob = malloc(65536); __nb = malloc(32); }\n"
+  "  __ot = 0; f = (char *)*--t;\n"
+  "  while (*f) {\n"
+  "    if (*f != '%') __put(*f++);\n"
+  "    else {\n"
+  "      ++f; left = zero = sg = w = l = 0; pr = -1;\n"
+  "      while (*f == '-' || *f == '0' || *f == '+' || *f == ' ' || *f == '#') {\n"
+  "        if (*f == '-') left = 1; else if (*f == '0') zero = 1; else if (*f == '+') sg = '+'; else if (*f == ' ' && !sg) sg = ' ';\n"
+  "        ++f;\n"
+  "      }\n"
+  "      if (*f == '*') { ++f; if ((w = *--t << 32 >> 32) < 0) { left = 1; w = -w; } }\n"
+  "      else while (*f >= '0' && *f <= '9') w = w * 10 + *f++ - '0';\n"
+  "      if (*f == '.') {\n"
+  "        ++f; pr = 0;\n"
+  "        if (*f == '*') { ++f; pr = *--t << 32 >> 32; } else while (*f >= '0' && *f <= '9') pr = pr * 10 + *f++ - '0';\n"
+  "      }\n"
+  "      while (*f == 'l' || *f == 'h' || *f == 'z') { if (*f == 'l') l = 1; ++f; }\n"
+  "      if (c = *f) ++f;\n"
+  "      s = 0;\n"
+  "      if (c == 'c') { s = __nb; *s = *--t; n = 1; }\n"
+  "      else if (c == 's') { if (!(s = (char *)*--t)) s = \"(null)\"; n = 0; while ((pr < 0 || n < pr) && s[n]) ++n; }\n"
+  "      else if (c == 'p' && !t[-1]) { --t; s = \"(nil)\"; n = 5; }\n"
+  "      if (s) { if (!left) __pad(w - n, ' '); k = 0; while (k < n) __put(s[k++]); if (left) __pad(w - n, ' '); }\n"
+  "      else if (c == '%') __put('%');\n"
+  "      else if (c == 'd' || c == 'i' || c == 'u' || c == 'x' || c == 'X' || c == 'o' || c == 'p') {\n"
+  "        x = *--t; d = (c == 'X') ? \"0123456789ABCDEF\" : \"0123456789abcdef\";\n"
+  "        b = (c == 'x' || c == 'X' || c == 'p') ? 16 : (c == 'o') ? 8 : 10;\n"
+  "        if (c == 'p') l = 1;\n"
+  "        if (c == 'd' || c == 'i') { if (!l) x = x << 32 >> 32; if (x < 0) sg = '-'; }\n"
+  "        else { sg = 0; if (!l) x = x & 0xffffffff; }\n"
+  "        s = __nb + 32; n = 0;\n"
+  "        if (x < 0 && sg != '-') { k = (x >> 1 & 0x7fffffffffffffff) / (b >> 1); *--s = d[x - k * b]; ++n; x = k; }\n"
+  "        while (x || (!n && pr)) { k = x % b; if (k < 0) k = -k; *--s = d[k]; ++n; x = x / b; }\n"
+  "        if (pr >= 0) zero = 0;\n"
+  "        k = (pr > n) ? pr : n; if (sg) ++k; if (c == 'p') k = k + 2;\n"
+  "        if (!left && !zero) __pad(w - k, ' ');\n"
+  "        if (sg) __put(sg); if (c == 'p') { __put('0'); __put('x'); }\n"
+  "        if (!left && zero) __pad(w - k, '0');\n"
+  "        __pad(pr - n, '0');\n"
+  "        while (n--) __put(*s++);\n"
+  "        if (left) __pad(w - k, ' ');\n"
+  "      }\n"
+  "      else if (c) { __put('%'); __put(c); }\n"
+  "    }\n"
+  "  }\n"
+  "  __iflush();\n"
+  "  return __ot;\n"
+  "}\n"
+  "int __fill()\n"
+  "{\n"
+  "  int n, k;\n"
+  "  if (!__ib) __ib = malloc(65536);\n"
+  "  if (__ip) { k = 0; while (__ip < __in) __ib[k++] = __ib[__ip++]; __in = k; __ip = 0; }\n"
+  "  __iflush();\n"
+  "  if ((n = read(0, __ib + __in, 65536 - __in)) <= 0) return 0;\n"
+  "  __in = __in + n;\n"
+  "  return n;\n"
+  "}\n"
+  "int __getc() { if (__ip == __in && !__fill()) return -1; return __ib[__ip++] & 255; }\n"
+  "int __getl(char *s, int n)\n"
+  "{\n"
+  "  int k;\n"
+  "  if (n <= 0) return 0;\n"
+  "  k = 0;\n"
+  "  while (k < n - 1 && (__ip < __in || __fill())) {\n"
+  "    if ((s[k++] = __ib[__ip++]) == '\\n') { s[k] = 0; return k; }\n"
+  "  }\n"
+  "  s[k] = 0;\n"
+  "  return k;\n"
+  "}\n"
+  "char *__malloc(int n)\n"
+  "{\n"
+  "  int c, *b;\n"
+  "  if (!__fl) __fl = (int *)malloc(64 * sizeof(int));\n"
+  "  c = 4; while (1 << c < n + 8) ++c;\n"
+  "  if (b = (int *)__fl[c]) __fl[c] = b[1];\n"
+  "  else if (!(b = (int *)malloc(1 << c))) return 0;\n"
+  "  *b = c;\n"
+  "  return (char *)(b + 1);\n"
+  "}\n"
+  "void __free(char *p) { int *b; if (p) { b = (int *)p - 1; b[1] = __fl[*b]; __fl[*b] = (int)b; } }\n";
+
+// parse the runtime once the program's source is done
+static int rtparse()
+{
+  aot = 2; rt0 = e + 1;
+  lp = p = rtsrc; pe = p + strlen(p);
+  next();
+  return tk;
+}
+
+// the start of runtime function s
+static int rtfun(char *s)
+{
+  lp = p = s; pe = p + strlen(p);
+  next();
+  return id[Val];
+}
+
+// green threads: spawn(f, arg) starts f(arg) as a task, yield() lets the next
+// ready task run and join(t) waits for task t to end and takes its value. A
+// task ends when its function returns or it calls exit(); main ending ends
+// them all. Tasks run on small stacks carved from a pool and committed as they
+// are touched; an engine switches tasks by passing its pc, sp, bp and a
+// through cor. All of it is per thread, so -P instances have their own.
+// read() and write() with other tasks alive first poll the fd; one that is not
+// ready puts the task to sleep on it in epoll, to retry once it is, and the
+// scheduler waits in epoll only when no task is ready
+enum { CoPc, CoSp, CoBp, CoA, CoStat, CoWait, CoNext, CoRes, CoStk, Cosz };
+enum { CoReady, CoBlocked, CoDone };
+
+static __thread int cor[4], // pc, sp, bp and a of the engine switching tasks
+  *cot,     // tasks, Cosz words each (the value in CoA once done); task 0 is main
+  ncot,     // tasks spawned, and main
+  cotsz,    // capacity of cot
+  cocur,    // running task
+  *coq,     // ring of ready tasks
+  coqh,     // its head,
+  coqt,     // tail
+  coqm,     // and size - 1
+  *cofree,  // tops of the free task stacks
+  ncofree,  // number of them
+  cofsz,    // capacity of cofree
+  costub,   // where task functions return to: the running engine's PSH; EXIT
+  colive,   // spawned tasks not yet done
+  coep,     // epoll instance, made on the first wait
+  *cofdw,   // per fd, first task waiting to read and first to write (chained through CoNext)
+  cofdsz,   // fds cofdw covers
+  conio;    // tasks waiting for an fd
+static int iotty;  // stdout is a terminal: flush it before waiting for input
+static int coexit[2] = { PSH, EXIT }; // that for the switch engine
+
+// a task stack back to the pool
+static void copool(int top)
+{
+  if (ncofree == cofsz) {
+    cofsz = cofsz ? cofsz * 2 : COBLK;
+    if (!(cofree = realloc(cofree, cofsz * sizeof(int)))) { printf("could not malloc task stack pool\n"); exit(-1); }
+  }
+  cofree[ncofree++] = top;
+}
+
+// the top of a task stack from the pool
+static int costack()
+{
+  char *m;
+  int i;
+
+  if (!ncofree) {
+    m = mmap(0, COBLK * COSTK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (m == MAP_FAILED) { printf("could not map task stacks\n"); exit(-1); }
+    i = COBLK;
+    while (i--) { mprotect(m + i * COSTK, 4096, PROT_NONE); copool((int)m + (i + 1) * COSTK); }
+    pthread_mutex_lock(&coblkm);
+    if (ncoblk < NCOBLK) { coblk[ncoblk] = (int)m; ++ncoblk; }
+    pthread_mutex_unlock(&coblkm);
+  }
+  return cofree[--ncofree];
+}
+
+static void coready(int k)
+{
+  int *q, n;
+
+  if (((coqt + 1) & coqm) == coqh) {
+    if (!(q = malloc((coqm + 1) * 2 * sizeof(int)))) { printf("could not malloc ready queue\n"); exit(-1); }
+    n = 0; while (coqh != coqt) { q[n++] = coq[coqh]; coqh = (coqh + 1) & coqm; }
+    free(coq); coq = q; coqh = 0; coqt = n; coqm = coqm * 2 + 1;
+  }
+  coq[coqt] = k; coqt = (coqt + 1) & coqm;
+}
+
+// watch fd in epoll for what the tasks waiting on it need, or not at all
+static int coarm(int fd)
+{
+  struct epoll_event ev;
+
+  ev.events = (cofdw[fd * 2] >= 0 ? EPOLLIN : 0) | (cofdw[fd * 2 + 1] >= 0 ? EPOLLOUT : 0);
+  ev.data.u64 = 0; ev.data.fd = fd;
+  if (!ev.events) return epoll_ctl(coep, EPOLL_CTL_DEL, fd, &ev);
+  if (!epoll_ctl(coep, EPOLL_CTL_MOD, fd, &ev)) return 0;
+  return epoll_ctl(coep, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// make every task waiting to read (out 0) or write fd ready
+static void cowake(int fd, int out)
+{
+  int w;
+
+  w = cofdw[fd * 2 + out]; cofdw[fd * 2 + out] = -1;
+  while (w >= 0) { coready(w); --conio; w = cot[w * Cosz + CoNext]; }
+}
+
+// wait for some fd a task sleeps on
+static void copoll()
+{
+  struct epoll_event ev[64];
+  int n, i, fd;
+
+  n = epoll_wait(coep, ev, 64, -1);
+  i = 0;
+  while (i < n) {
+    fd = ev[i].data.fd;
+    if (ev[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) cowake(fd, 0);
+    if (ev[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) cowake(fd, 1);
+    coarm(fd);
+    ++i;
+  }
+}
+
+// an engine starts: main is the only task, and stub where task functions return
+static void coinit(int stub)
+{
+  int i;
+
+  if (!cot) {
+    cotsz = coqm = 63;
+    if (!(cot = malloc((cotsz + 1) * Cosz * sizeof(int))) || !(coq = malloc((coqm + 1) * sizeof(int)))) {
+      printf("could not malloc tasks\n"); exit(-1);
+    }
+  }
+  i = 1;
+  while (i < ncot) { if (cot[i * Cosz + CoStat] != CoDone) copool(cot[i * Cosz + CoStk]); ++i; } // from an earlier run
+  memset(cot, 0, Cosz * sizeof(int));
+  cot[CoWait] = -1;
+  ncot = 1; cocur = coqh = coqt = colive = conio = 0; costub = stub;
+  if (coep) { close(coep); coep = 0; }
+  if (cofdw) memset(cofdw, -1, cofdsz * 2 * sizeof(int));
+}
+
+// f is a function's start in the text
+static int cofun(int f) { return f > (int)text && f <= (int)e && *(int *)f == ENT; }
+
+// a new ready task running the engine's code at pc on arg
+static int cospawn(int pc, int arg)
+{
+  int *t, *sp;
+
+  if (ncot > cotsz) {
+    cotsz = cotsz * 2 + 1;
+    if (!(cot = realloc(cot, (cotsz + 1) * Cosz * sizeof(int)))) { printf("could not malloc tasks\n"); exit(-1); }
+  }
+  t = cot + ncot * Cosz;
+  memset(t, 0, Cosz * sizeof(int));
+  t[CoStk] = costack(); sp = (int *)t[CoStk];
+  *--sp = arg; *--sp = costub;
+  t[CoPc] = pc; t[CoSp] = t[CoBp] = (int)sp; t[CoWait] = -1;
+  coready(ncot); ++colive;
+  return ncot++;
+}
+
+// leave the running task, unless it is done, for the next ready one
+static void coswitch()
+{
+  int *t;
+
+  t = cot + cocur * Cosz;
+  if (t[CoStat] != CoDone) { t[CoPc] = cor[0]; t[CoSp] = cor[1]; t[CoBp] = cor[2]; t[CoA] = cor[3]; }
+  while (coqh == coqt) {
+    if (!conio) { printf("deadlock: every task is waiting in join()\n"); exit(-1); }
+    copoll();
+  }
+  cocur = coq[coqh]; coqh = (coqh + 1) & coqm;
+  t = cot + cocur * Cosz;
+  t[CoStat] = CoReady;
+  cor[0] = t[CoPc]; cor[1] = t[CoSp]; cor[2] = t[CoBp]; cor[3] = t[CoA];
+}
+
+static void coyield() { coready(cocur); coswitch(); }
+
+// wait for task k; its value in a, and at res too if the engine wants it there
+static void cojoin(int k, int *res)
+{
+  int *t;
+
+  if (k < 1 || k >= ncot || k == cocur) { cor[3] = -1; if (res) *res = -1; return; }
+  t = cot + k * Cosz;
+  if (t[CoStat] == CoDone) { cor[3] = t[CoA]; if (res) *res = t[CoA]; return; }
+  cot[cocur * Cosz + CoStat] = CoBlocked; cot[cocur * Cosz + CoRes] = (int)res;
+  cot[cocur * Cosz + CoNext] = t[CoWait]; t[CoWait] = cocur;
+  coswitch();
+}
+
+// the running task ends with value v: wake its joiners, free its stack
+static void coend(int v)
+{
+  int *t, *u, w;
+
+  t = cot + cocur * Cosz;
+  t[CoStat] = CoDone; t[CoA] = v; --colive;
+  w = t[CoWait];
+  while (w >= 0) {
+    u = cot + w * Cosz;
+    u[CoA] = v; if (u[CoRes]) *(int *)u[CoRes] = v;
+    coready(w); w = u[CoNext];
+  }
+  copool(t[CoStk]);
+  coswitch();
+}
+
+// put the running task to sleep until fd is ready to read (out 0) or write;
+// -1 if epoll cannot watch it
+static int cowait(int fd, int out)
+{
+  int n;
+
+  if (fd < 0 || (!coep && (coep = epoll_create1(EPOLL_CLOEXEC)) < 0)) { coep = 0; return -1; }
+  if (fd >= cofdsz) {
+    n = (fd + 64) * 2;
+    if (!(cofdw = realloc(cofdw, n * 2 * sizeof(int)))) { printf("could not malloc fd waiters\n"); exit(-1); }
+    memset(cofdw + cofdsz * 2, -1, (n - cofdsz) * 2 * sizeof(int));
+    cofdsz = n;
+  }
+  cot[cocur * Cosz + CoNext] = cofdw[fd * 2 + out]; cofdw[fd * 2 + out] = cocur;
+  if (coarm(fd)) { cofdw[fd * 2 + out] = cot[cocur * Cosz + CoNext]; return -1; }
+  cot[cocur * Cosz + CoStat] = CoBlocked; ++conio;
+  return 0;
+}
+
+// read (out 0) or write n bytes at b on fd, the count in cor[3]. With other
+// tasks alive and fd not ready the task sleeps instead, to run the same
+// instruction again (step back from cor[0]) when it wakes: 1 if so
+static int corw(int fd, char *b, int n, int out, int step)
+{
+  struct pollfd q;
+
+  if (out ? fd == 1 || fd == 2 : iotty) fflush(stdout); // keep order with printf
+  if (colive) {
+    q.fd = fd; q.events = out ? POLLOUT : POLLIN; q.revents = 0;
+    if (!poll(&q, 1, 0) && !cowait(fd, out)) { cor[0] = cor[0] - step; coswitch(); return 1; }
+  }
+  cor[3] = out ? write(fd, b, n) : read(fd, b, n);
+  return 0;
+}
+
+// close fd, waking whoever waits on it to fail
+static int coclose(int fd)
+{
+  if (fd >= 0 && fd < cofdsz) { cowake(fd, 0); cowake(fd, 1); if (coep) coarm(fd); }
+  return close(fd);
+}
+
+// hand the engine's registers to a scheduler call and take back the next task's
+#define COSW(x) cor[0] = (int)pc; cor[1] = (int)sp; cor[2] = (int)bp; cor[3] = a; x; \
+                pc = (void *)cor[0]; sp = (int *)cor[1]; bp = (int *)cor[2]; a = cor[3]
+
+// buffered I/O: printf writes %d, %s and %c itself into stdout's buffer (64K
+// unless stdout is a terminal, flushed at a newline if it is, when full and
+// at exit) and hands any other conversion, with the rest of the format, to
+// the host's. getchar() and getline(s, n) read stdin through a buffer of
+// their own, so read(0, ...) does not see what they have taken. A refill
+// that would block suspends the task like read() does
+#define IOBUF 65536
+
+static __thread char *inb; // stdin buffer
+static __thread int inpos,  // next byte in it
+  inlen,             // bytes in it
+  ineof;             // the last refill found the end of input
+
+// a program's printf: f, then at most five arguments below t
+static int ioprintf(char *f, int *t)
+{
+  char b[24], *s, *q;
+  int n, v, k;
+  unsigned long long u;
+
+  flockfile(stdout);
+  n = 0;
+  while (*f) {
+    if (*f != '%') {
+      s = f; while (*f && *f != '%') ++f;
+      fwrite_unlocked(s, 1, f - s, stdout); n = n + (f - s);
+    }
+    else if (f[1] == 'd') {
+      v = *--t << 32 >> 32; u = v < 0 ? -v : v; // as int, like the host's %d
+      q = b + sizeof(b);
+      do { *--q = '0' + u % 10; u = u / 10; } while (u);
+      if (v < 0) *--q = '-';
+      k = b + sizeof(b) - q; fwrite_unlocked(q, 1, k, stdout); n = n + k; f = f + 2;
+    }
+    else if (f[1] == 's') {
+      if (!(s = (char *)*--t)) s = "(null)";
+      k = strlen(s); fwrite_unlocked(s, 1, k, stdout); n = n + k; f = f + 2;
+    }
+    else if (f[1] == 'c') { putc_unlocked(*--t, stdout); ++n; f = f + 2; }
+    else if (f[1] == '%') { putc_unlocked('%', stdout); ++n; f = f + 2; }
+    else { n = n + printf(f, t[-1], t[-2], t[-3], t[-4], t[-5]); f = ""; }
   }
-  else if (tk == '{') {
-    next();
-    while (tk != '}') stmt();
-    next();
+  funlockfile(stdout);
+  return n;
+}
+
+// refill the stdin buffer, keeping what is unread: 1 if the task was suspended
+// to run the instruction again (step back from cor[0]) once stdin is ready
+static int ioneed(int step)
+{
+  struct pollfd q;
+  int n;
+
+  if (!inb && !(inb = malloc(IOBUF))) { printf("could not malloc input buffer\n"); exit(-1); }
+  if (inpos) { memmove(inb, inb + inpos, inlen - inpos); inlen = inlen - inpos; inpos = 0; }
+  if (inlen == IOBUF) return 0;
+  if (colive) {
+    q.fd = 0; q.events = POLLIN; q.revents = 0;
+    if (!poll(&q, 1, 0) && !cowait(0, 0)) { cor[0] = cor[0] - step; coswitch(); return 1; }
   }
-  else if (tk == ';') {
-    next();
+  if (iotty) fflush(stdout);
+  if ((n = read(0, inb + inlen, IOBUF - inlen)) > 0) inlen = inlen + n; else ineof = 1;
+  return 0;
+}
+
+// getchar(): the next byte of stdin, -1 at its end
+static int iogetc(int step)
+{
+  if (inpos == inlen) { ineof = 0; if (ioneed(step)) return 1; }
+  cor[3] = inpos < inlen ? inb[inpos++] & 255 : -1;
+  return 0;
+}
+
+// getline(s, n): the next line of stdin with its newline, at most n - 1 bytes
+// of it, into s; the length, 0 at the end of input
+static int iogetl(char *s, int n, int step)
+{
+  char *q;
+  int k;
+
+  ineof = 0;
+  while (1) {
+    q = inlen > inpos ? memchr(inb + inpos, '\n', inlen - inpos) : 0;
+    if (q || inlen - inpos >= n - 1 || inlen - inpos == IOBUF || ineof) break;
+    if (ioneed(step)) return 1; // nothing taken yet, so running it again is safe
+  }
+  k = q ? q + 1 - (inb + inpos) : inlen - inpos;
+  if (k > n - 1) k = n - 1;
+  if (k < 0) k = 0;
+  if (n > 0) { memcpy(s, inb + inpos, k); s[k] = 0; }
+  inpos = inpos + k; cor[3] = k;
+  return 0;
+}
+
+// for the JIT, whose programs have no tasks to suspend
+static int jgetc() { iogetc(0); return cor[3]; }
+static int jgetl(char *s, int n) { iogetl(s, n, 0); return cor[3]; }
+static int jrw(int fd, char *b, int n, int out) { corw(fd, b, n, out, 0); return cor[3]; }
+
+// instruction semantics shared by the dispatch engines: VMOP(opcode, effect)
+// with pc already past the opcode
+#define VMOPS \
+  VMOP(LEA,  a = (int)(bp + *pc++))                             /* load local address */ \
+  VMOP(IMM,  a = *pc++)                                         /* load global address or immediate */ \
+  VMOP(JMP,  pc = (int *)*pc)                                   /* jump */ \
+  VMOP(JSR,  *--sp = (int)(pc + 1); pc = (int *)*pc)            /* jump to subroutine */ \
+  VMOP(BZ,   pc = a ? pc + 1 : (int *)*pc)                      /* branch if zero */ \
+  VMOP(BNZ,  pc = a ? (int *)*pc : pc + 1)                      /* branch if not zero */ \
+  VMOP(EQBZ, pc = (a = *sp++ == a) ? pc + 1 : (int *)*pc)       /* compare, branch if false */ \
+  VMOP(NEBZ, pc = (a = *sp++ != a) ? pc + 1 : (int *)*pc) \
+  VMOP(LTBZ, pc = (a = *sp++ <  a) ? pc + 1 : (int *)*pc) \
+  VMOP(GTBZ, pc = (a = *sp++ >  a) ? pc + 1 : (int *)*pc) \
+  VMOP(LEBZ, pc = (a = *sp++ <= a) ? pc + 1 : (int *)*pc) \
+  VMOP(GEBZ, pc = (a = *sp++ >= a) ? pc + 1 : (int *)*pc) \
+  VMOP(ENT,  *--sp = (int)bp; bp = sp; sp = sp - *pc++)         /* enter subroutine */ \
+  VMOP(ADDI, a = a + *pc++)                                     /* add immediate */ \
+  VMOP(MULI, a = a * *pc++) \
+  VMOP(DIVI, a = a / *pc++) \
+  VMOP(MODI, a = a % *pc++) \
+  VMOP(SHLI, a = a << *pc++) \
+  VMOP(SHRI, a = a >> *pc++) \
+  VMOP(LL,   a = bp[*pc++])                                     /* load local int */ \
+  VMOP(LG,   a = *(int *)*pc++)                                 /* load global int */ \
+  VMOP(SL,   bp[*pc++] = a)                                     /* store local int */ \
+  VMOP(SG,   *(int *)*pc++ = a)                                 /* store global int */ \
+  VMOP(TSR,  memcpy(bp + 2, sp, *pc++ * sizeof(int));            /* arguments over the caller's, */ \
+             sp = bp + 1; bp = (int *)*bp)                      /* then leave but keep the return */ \
+  VMOP(ADJ,  sp = sp + *pc++)                                   /* stack adjust */ \
+  VMOP(LEV,  sp = bp; bp = (int *)*sp++; pc = (int *)*sp++)     /* leave subroutine */ \
+  VMOP(LI,   a = *(int *)a)                                     /* load int */ \
+  VMOP(LC,   a = *(char *)a)                                    /* load char */ \
+  VMOP(SI,   *(int *)*sp++ = a)                                 /* store int */ \
+  VMOP(SC,   a = *(char *)*sp++ = a)                            /* store char */ \
+  VMOP(PSH,  *--sp = a)                                         /* push */ \
+  VMOP(OR,   a = *sp++ |  a) \
+  VMOP(XOR,  a = *sp++ ^  a) \
+  VMOP(AND,  a = *sp++ &  a) \
+  VMOP(EQ,   a = *sp++ == a) \
+  VMOP(NE,   a = *sp++ != a) \
+  VMOP(LT,   a = *sp++ <  a) \
+  VMOP(GT,   a = *sp++ >  a) \
+  VMOP(LE,   a = *sp++ <= a) \
+  VMOP(GE,   a = *sp++ >= a) \
+  VMOP(SHL,  a = *sp++ << a) \
+  VMOP(SHR,  a = *sp++ >> a) \
+  VMOP(ADD,  a = *sp++ +  a) \
+  VMOP(SUB,  a = *sp++ -  a) \
+  VMOP(MUL,  a = *sp++ *  a) \
+  VMOP(DIV,  a = *sp++ /  a) \
+  VMOP(MOD,  a = *sp++ %  a) \
+  VMOP(NOT,  a = ~*sp++)                                        /* added bitwise NOT */ \
+  VMOP(NEG,  a = -a) \
+  VMOP(EQZ,  a = !a) \
+  VMOP(OPEN, a = open((char *)sp[1], *sp)) \
+  VMOP(READ, COSW(corw(sp[2], (char *)sp[1], *sp, 0, sizeof(int)))) \
+  VMOP(WRIT, COSW(corw(sp[2], (char *)sp[1], *sp, 1, sizeof(int)))) \
+  VMOP(CLOS, a = coclose(*sp)) \
+  VMOP(PRTF, t = sp + pc[1]; a = ioprintf((char *)t[-1], t - 1)) \
+  VMOP(MALC, a = (int)malloc(*sp)) \
+  VMOP(FREE, free((void *)*sp)) \
+  VMOP(MSET, a = (int)memset((char *)sp[2], sp[1], *sp)) \
+  VMOP(MCMP, a = memcmp((char *)sp[2], (char *)sp[1], *sp)) \
+  VMOP(SPWN, a = cofun(sp[1]) ? cospawn((int)(th + ((int *)sp[1] - text)), *sp) : -1) \
+  VMOP(YLD,  COSW(coyield())) \
+  VMOP(JOIN, COSW(cojoin(*sp, 0))) \
+  VMOP(GETC, COSW(iogetc(sizeof(int)))) \
+  VMOP(GETL, COSW(iogetl((char *)sp[1], *sp, sizeof(int)))) \
+  VMOP(DIVS, a = a + (a >> 63 & (1LL << *pc) - 1) >> *pc; ++pc) \
+  VMOP(MODS, a = a - (a + (a >> 63 & (1LL << *pc) - 1) & -(1LL << *pc)); ++pc) \
+  VMOP(EXIT, if (cocur) { COSW(coend(*sp)); }                     /* a task ends, */ \
+             else { printf("exit(%d) cycle = %d\n", *sp, cycle); return *sp; }) /* main ends all */
+
+// -p: print the most frequent executed opcode pairs
+static void pairs()
+{
+  int i, j, n, m, tot;
+
+  tot = 0; i = 0;
+  while (i < (EXIT + 1) * (EXIT + 1)) tot = tot + hist[i++];
+  printf("opcode pairs (%d dispatches):\n", tot);
+  n = 0;
+  while (n < 24) {
+    m = 0; i = 1;
+    while (i < (EXIT + 1) * (EXIT + 1)) { if (hist[i] > hist[m]) m = i; ++i; }
+    if (!hist[m]) return;
+    i = m / (EXIT + 1); j = m % (EXIT + 1);
+    printf("%12d %3d.%d%%  %.4s %.4s\n", hist[m], (int)(hist[m] * 100 / tot), (int)(hist[m] * 1000 / tot % 10),
+      &opname[i * 5], &opname[j * 5]);
+    hist[m] = 0; ++n;
+  }
+}
+
+// switch dispatch: portable, and the engine used for tracing (-d) and profiling (-p)
+static int runsw(int *pc, int *bp, int *sp)
+{
+  int a, i, *t, cycle, last, *th;
+
+  a = cycle = last = 0;
+  th = text; coinit((int)coexit); // spawn() starts tasks in the text itself
+  while (1) {
+    i = *pc++; ++cycle;
+    if (debug) {
+      printf("%d> %.4s", cycle, &opname[i * 5]);
+      if (i <= ADJ) printf(" %d\n", *pc); else printf("\n");
+    }
+    if (hist) { ++hist[last * (EXIT + 1) + i]; last = i; if (i == EXIT && !cocur) pairs(); }
+    switch (i) {
+#define VMOP(o, ...) case o: __VA_ARGS__; break;
+    VMOPS
+#undef VMOP
+    default: printf("unknown instruction = %d! cycle = %d\n", i, cycle); return -1;
+    }
+  }
+}
+
+#ifdef __GNUC__
+// direct threading: the text is pre-decoded into handler addresses, branch
+// operands into addresses in the decoded copy, and every handler ends in its
+// own indirect jump (labels as values)
+static int runth(int *pc, int *bp, int *sp)
+{
+  void *lab[EXIT + 1];
+  int a, *t, cycle, *th, *q, n;
+
+  memset(lab, 0, sizeof(lab));
+#define VMOP(o, ...) lab[o] = &&L_##o;
+  VMOPS
+#undef VMOP
+  n = e - text + 1;
+  if (!(th = malloc((n + 2) * sizeof(int)))) { printf("could not malloc threaded code\n"); return -1; }
+  q = text + 1;
+  while (q <= e) {
+    if (*q < 0 || *q > EXIT || !lab[*q]) { printf("unknown instruction = %d!\n", *q); return -1; }
+    th[q - text] = (int)lab[*q];
+    if (*q <= ADJ) {
+      th[q + 1 - text] = (*q == JSR || isbr(*q)) ? (int)(th + ((int *)q[1] - text)) : q[1];
+      q = q + 2;
+    }
+    else ++q;
+  }
+  th[n] = (int)lab[PSH]; th[n + 1] = (int)lab[EXIT]; // exit stub main returns into
+  *sp = (int)(th + n);
+  pc = th + (pc - text);
+  coinit((int)(th + n));
+  a = 0; cycle = 1;
+  goto *(void *)*pc++;
+#define VMOP(o, ...) L_##o: __VA_ARGS__; ++cycle; goto *(void *)*pc++;
+  VMOPS
+#undef VMOP
+}
+#else
+static int runth(int *pc, int *bp, int *sp) { return runsw(pc, bp, sp); }
+#endif
+
+// register instruction semantics: RVMOP(opcode, effect) with pc at the
+// first operand; R(i) is the register named by operand i
+#define R(i) bp[pc[i]]
+#define RSYS(x) x; sp = sp + *pc; R(1) = a; pc = pc + 2
+#define RVMOPS \
+  RVMOP(RHALT, if (cocur) { COSW(coend(a)); }                           /* a task returned, */ \
+               else { printf("exit(%d) cycle = %d\n", a, cycle); return a; }) /* or main */ \
+  RVMOP(RJMP,  pc = (int *)*pc) \
+  RVMOP(RJSR,  *--sp = (int)(pc + 1); pc = (int *)*pc) \
+  RVMOP(RENT,  *--sp = (int)bp; bp = sp; sp = sp - *pc++)                 /* locals and temporaries */ \
+  RVMOP(RLEV,  a = R(0); sp = bp; bp = (int *)*sp++; pc = (int *)*sp++) \
+  RVMOP(RPSH,  *--sp = R(0); ++pc) \
+  RVMOP(RPSHI, *--sp = *pc++) \
+  RVMOP(RTSR,  memcpy(bp + 2, sp, *pc++ * sizeof(int)); sp = bp + 1; bp = (int *)*bp) \
+  RVMOP(RMOV,  R(0) = R(1); pc = pc + 2) \
+  RVMOP(RIMM,  R(0) = pc[1]; pc = pc + 2) \
+  RVMOP(RLEA,  R(0) = (int)(bp + pc[1]); pc = pc + 2) \
+  RVMOP(RLI,   R(0) = *(int *)R(1); pc = pc + 2) \
+  RVMOP(RLC,   R(0) = *(char *)R(1); pc = pc + 2) \
+  RVMOP(RLG,   R(0) = *(int *)pc[1]; pc = pc + 2) \
+  RVMOP(RSG,   *(int *)pc[0] = R(1); pc = pc + 2) \
+  RVMOP(RSI,   *(int *)R(0) = R(1); pc = pc + 2) \
+  RVMOP(RBZ,   pc = R(0) ? pc + 2 : (int *)pc[1]) \
+  RVMOP(RBNZ,  pc = R(0) ? (int *)pc[1] : pc + 2) \
+  RVMOP(RNEG,  R(0) = -R(1); pc = pc + 2) \
+  RVMOP(REQZ,  R(0) = !R(1); pc = pc + 2) \
+  RVMOP(RNOT,  R(0) = ~R(1); pc = pc + 2) \
+  RVMOP(RRET,  RSYS())                                                    /* pop arguments, R(1) = a */ \
+  RVMOP(ROPEN, RSYS(a = open((char *)sp[1], *sp))) \
+  RVMOP(RREAD, COSW(t = (int *)corw(sp[2], (char *)sp[1], *sp, 0, sizeof(int))); if (!t) { RSYS(); }) \
+  RVMOP(RWRIT, COSW(t = (int *)corw(sp[2], (char *)sp[1], *sp, 1, sizeof(int))); if (!t) { RSYS(); }) \
+  RVMOP(RCLOS, RSYS(a = coclose(*sp))) \
+  RVMOP(RPRTF, RSYS(t = sp + *pc; a = ioprintf((char *)t[-1], t - 1))) \
+  RVMOP(RMALC, RSYS(a = (int)malloc(*sp))) \
+  RVMOP(RFREE, RSYS(free((void *)*sp))) \
+  RVMOP(RMSET, RSYS(a = (int)memset((char *)sp[2], sp[1], *sp))) \
+  RVMOP(RMCMP, RSYS(a = memcmp((char *)sp[2], (char *)sp[1], *sp))) \
+  RVMOP(RSPWN, RSYS(a = cofun(sp[1]) ? cospawn(rmap[(int *)sp[1] - text], *sp) : -1)) \
+  RVMOP(RYLD,  RSYS(); COSW(coyield())) \
+  RVMOP(RJOIN, RSYS(t = (int *)*sp); COSW(cojoin((int)t, &R(-1))))      /* the result register set on wake */ \
+  RVMOP(RGETC, COSW(t = (int *)iogetc(sizeof(int))); if (!t) { RSYS(); }) \
+  RVMOP(RGETL, COSW(t = (int *)iogetl((char *)sp[1], *sp, sizeof(int))); if (!t) { RSYS(); }) \
+  RVMOP(REXIT, if (cocur) { COSW(coend(*sp)); } else { printf("exit(%d) cycle = %d\n", *sp, cycle); return *sp; }) \
+  RVMOP(RSC,   R(0) = *(char *)R(1) = R(2); pc = pc + 3) \
+  RVMOP(ROR,   R(0) = R(1) |  R(2); pc = pc + 3) \
+  RVMOP(RXOR,  R(0) = R(1) ^  R(2); pc = pc + 3) \
+  RVMOP(RAND,  R(0) = R(1) &  R(2); pc = pc + 3) \
+  RVMOP(REQ,   R(0) = R(1) == R(2); pc = pc + 3) \
+  RVMOP(RNE,   R(0) = R(1) != R(2); pc = pc + 3) \
+  RVMOP(RLT,   R(0) = R(1) <  R(2); pc = pc + 3) \
+  RVMOP(RGT,   R(0) = R(1) >  R(2); pc = pc + 3) \
+  RVMOP(RLE,   R(0) = R(1) <= R(2); pc = pc + 3) \
+  RVMOP(RGE,   R(0) = R(1) >= R(2); pc = pc + 3) \
+  RVMOP(RSHL,  R(0) = R(1) << R(2); pc = pc + 3) \
+  RVMOP(RSHR,  R(0) = R(1) >> R(2); pc = pc + 3) \
+  RVMOP(RADD,  R(0) = R(1) +  R(2); pc = pc + 3) \
+  RVMOP(RSUB,  R(0) = R(1) -  R(2); pc = pc + 3) \
+  RVMOP(RMUL,  R(0) = R(1) *  R(2); pc = pc + 3) \
+  RVMOP(RDIV,  R(0) = R(1) /  R(2); pc = pc + 3) \
+  RVMOP(RMOD,  R(0) = R(1) %  R(2); pc = pc + 3) \
+  RVMOP(RADDI, R(0) = R(1) +  pc[2]; pc = pc + 3) \
+  RVMOP(RMULI, R(0) = R(1) *  pc[2]; pc = pc + 3) \
+  RVMOP(RDIVI, R(0) = R(1) /  pc[2]; pc = pc + 3) \
+  RVMOP(RMODI, R(0) = R(1) %  pc[2]; pc = pc + 3) \
+  RVMOP(RDIVS, R(0) = R(1) + (R(1) >> 63 & (1LL << pc[2]) - 1) >> pc[2]; pc = pc + 3) \
+  RVMOP(RMODS, R(0) = R(1) - (R(1) + (R(1) >> 63 & (1LL << pc[2]) - 1) & -(1LL << pc[2])); pc = pc + 3) \
+  RVMOP(RSHLI, R(0) = R(1) << pc[2]; pc = pc + 3) \
+  RVMOP(RSHRI, R(0) = R(1) >> pc[2]; pc = pc + 3) \
+  RVMOP(REQBZ, pc = (R(0) == R(1)) ? pc + 3 : (int *)pc[2])               /* branch unless R(0) == R(1) */ \
+  RVMOP(RNEBZ, pc = (R(0) != R(1)) ? pc + 3 : (int *)pc[2]) \
+  RVMOP(RLTBZ, pc = (R(0) <  R(1)) ? pc + 3 : (int *)pc[2]) \
+  RVMOP(RGTBZ, pc = (R(0) >  R(1)) ? pc + 3 : (int *)pc[2]) \
+  RVMOP(RLEBZ, pc = (R(0) <= R(1)) ? pc + 3 : (int *)pc[2]) \
+  RVMOP(RGEBZ, pc = (R(0) >= R(1)) ? pc + 3 : (int *)pc[2]) \
+  RVMOP(REQBI, pc = (R(0) == pc[1]) ? pc + 3 : (int *)pc[2])              /* branch unless R(0) == immediate */ \
+  RVMOP(RNEBI, pc = (R(0) != pc[1]) ? pc + 3 : (int *)pc[2]) \
+  RVMOP(RLTBI, pc = (R(0) <  pc[1]) ? pc + 3 : (int *)pc[2]) \
+  RVMOP(RGTBI, pc = (R(0) >  pc[1]) ? pc + 3 : (int *)pc[2]) \
+  RVMOP(RLEBI, pc = (R(0) <= pc[1]) ? pc + 3 : (int *)pc[2]) \
+  RVMOP(RGEBI, pc = (R(0) >= pc[1]) ? pc + 3 : (int *)pc[2])
+
+// register engine: threaded like runth where labels as values exist (the
+// register code is rewritten to handler addresses in place), else a switch
+static int runrg(int *pc, int *bp, int *sp)
+{
+  int a, *t, cycle;
+#ifdef __GNUC__
+  void *lab[RGEBI + 1];
+
+#define RVMOP(o, ...) lab[o] = &&L_##o;
+  RVMOPS
+#undef RVMOP
+  t = rtext + 1;
+  while (t <= re) { a = *t; *t = (int)lab[a]; t = t + rlen(a); }
+  a = 0; cycle = 1; coinit((int)re);
+  goto *(void *)*pc++;
+#define RVMOP(o, ...) L_##o: __VA_ARGS__; ++cycle; goto *(void *)*pc++;
+  RVMOPS
+#undef RVMOP
+#else
+  a = cycle = 0; coinit((int)re);
+  while (1) {
+    ++cycle;
+    switch (*pc++) {
+#define RVMOP(o, ...) case o: __VA_ARGS__; break;
+    RVMOPS
+#undef RVMOP
+    default: printf("unknown register instruction = %d! cycle = %d\n", pc[-1], cycle); return -1;
+    }
+  }
+#endif
+}
+#undef R
+#undef RSYS
+
+// compact engine (-xc): the finished text re-encoded with one-byte opcodes,
+// one per operand width for the instructions up to ADJ (one, four or eight
+// bytes, or four bytes of offset into data for the address of a global) and
+// the others after those, globals as offsets
+// into data and branch targets relative to the next instruction. Nothing in it
+// points into data, so instances with data of their own can share it (-P)
+static char *ctext, // compact code
+     *cstub; // PSH; EXIT after it, where main returns
+static int *cmap;   // byte offset of the instruction at each text word, else -1
+
+#define CW(o, w) ((o) + (w) * (ADJ + 1)) // o with an operand of width w
+#define CN(o) ((o) + 3 * (ADJ + 1))        // o without one
+
+// encoded length of the instruction at q
+static int clen(int *q)
+{
+  if (*q > ADJ) return 1;
+  if ((*q >= JMP && *q <= GEBZ) || *q == LG || *q == SG) return 5;
+  if ((*q == IMM || *q == ADDI) && rsec[q + 1 - text] == RelData) return 5;
+  if (q[1] >= -128 && q[1] < 128) return 2;
+  return (q[1] >= -2147483647 - 1 && q[1] <= 2147483647) ? 5 : 9;
+}
+
+static int compact()
+{
+  int *q, n, o, k, w;
+  char *c;
+
+  n = e - text + 2;
+  if (!(cmap = malloc(n * sizeof(int)))) { printf("could not malloc compact map\n"); return -1; }
+  memset(cmap, -1, n * sizeof(int));
+  q = text + 1; k = 0;
+  while (q <= e) { cmap[q - text] = k; k = k + clen(q); q = q + (*q <= ADJ ? 2 : 1); }
+  if (!(ctext = malloc(k + 2))) { printf("could not malloc compact code\n"); return -1; }
+  c = ctext; q = text + 1;
+  while (q <= e) {
+    o = *q; n = clen(q);
+    if (o > ADJ) { *c++ = CN(o); ++q; continue; }
+    k = q[1];
+    if (o >= JMP && o <= GEBZ) {
+      if ((int *)k <= text || (int *)k > e || cmap[(int *)k - text] < 0) {
+        printf("branch into no instruction at %d\n", (int)(q - text)); return -1;
+      }
+      k = cmap[(int *)k - text] - (c + 5 - ctext);
+    }
+    w = n == 2 ? 0 : n == 5 ? 1 : 2;
+    if (o == LG || o == SG) k = k - (int)data0;
+    else if ((o == IMM || o == ADDI) && rsec[q + 1 - text] == RelData) { k = k - (int)data0; w = 3; }
+    *c++ = CW(o, w);
+    memcpy(c, &k, n - 1); c = c + n - 1; // little endian
+    q = q + 2;
+  }
+  cstub = c; *c++ = CN(PSH); *c++ = CN(EXIT);
+  if (stats) printf("compact: %d words (%d bytes) -> %d bytes\n", (int)(e - text), (int)((e - text) * sizeof(int)), (int)(c - ctext));
+  return 0;
+}
+
+// spawn(f, arg) in the compact code of context x
+static int cxspawn(int *x, int f, int arg)
+{
+  if (f <= x[CxText] || f > x[CxE] || *(int *)f != ENT) return -1;
+  return cospawn(x[CxCtext] + ((int *)x[CxCmap])[(int *)f - (int *)x[CxText]], arg);
+}
+
+// fetch the operand of width w and step over the instruction
+#define CK(w) k = (w) == 0 ? ((signed char *)pc)[1] : (w) == 1 ? *(signed *)(pc + 1) : *(int *)(pc + 1); \
+              pc = pc + ((w) == 0 ? 2 : (w) == 1 ? 5 : 9)
+#define CVMOPS \
+  CVOPK(LEA,  a = (int)(bp + k)) \
+  CVOPK(IMM,  a = k) \
+  CVOPK(JMP,  pc = pc + k) \
+  CVOPK(JSR,  *--sp = (int)pc; pc = pc + k) \
+  CVOPK(BZ,   if (!a) pc = pc + k) \
+  CVOPK(BNZ,  if (a) pc = pc + k) \
+  CVOPK(EQBZ, if (!(a = *sp++ == a)) pc = pc + k) \
+  CVOPK(NEBZ, if (!(a = *sp++ != a)) pc = pc + k) \
+  CVOPK(LTBZ, if (!(a = *sp++ <  a)) pc = pc + k) \
+  CVOPK(GTBZ, if (!(a = *sp++ >  a)) pc = pc + k) \
+  CVOPK(LEBZ, if (!(a = *sp++ <= a)) pc = pc + k) \
+  CVOPK(GEBZ, if (!(a = *sp++ >= a)) pc = pc + k) \
+  CVOPK(ENT,  *--sp = (int)bp; bp = sp; sp = sp - k) \
+  CVOPK(ADDI, a = a + k) \
+  CVOPK(MULI, a = a * k) \
+  CVOPK(DIVI, a = a / k) \
+  CVOPK(MODI, a = a % k) \
+  CVOPK(DIVS, a = a + (a >> 63 & (1LL << k) - 1) >> k) \
+  CVOPK(MODS, a = a - (a + (a >> 63 & (1LL << k) - 1) & -(1LL << k))) \
+  CVOPK(SHLI, a = a << k) \
+  CVOPK(SHRI, a = a >> k) \
+  CVOPK(LL,   a = bp[k]) \
+  CVOPK(LG,   a = *(int *)(d + k)) \
+  CVOPK(SL,   bp[k] = a) \
+  CVOPK(SG,   *(int *)(d + k) = a) \
+  CVOPK(TSR,  memcpy(bp + 2, sp, k * sizeof(int)); sp = bp + 1; bp = (int *)*bp) \
+  CVOPK(ADJ,  sp = sp + k) \
+  CVOP(LEV,  sp = bp; bp = (int *)*sp++; pc = (char *)*sp++) \
+  CVOP(LI,   a = *(int *)a) \
+  CVOP(LC,   a = *(char *)a) \
+  CVOP(SI,   *(int *)*sp++ = a) \
+  CVOP(SC,   a = *(char *)*sp++ = a) \
+  CVOP(PSH,  *--sp = a) \
+  CVOP(OR,   a = *sp++ |  a) \
+  CVOP(XOR,  a = *sp++ ^  a) \
+  CVOP(AND,  a = *sp++ &  a) \
+  CVOP(EQ,   a = *sp++ == a) \
+  CVOP(NE,   a = *sp++ != a) \
+  CVOP(LT,   a = *sp++ <  a) \
+  CVOP(GT,   a = *sp++ >  a) \
+  CVOP(LE,   a = *sp++ <= a) \
+  CVOP(GE,   a = *sp++ >= a) \
+  CVOP(SHL,  a = *sp++ << a) \
+  CVOP(SHR,  a = *sp++ >> a) \
+  CVOP(ADD,  a = *sp++ +  a) \
+  CVOP(SUB,  a = *sp++ -  a) \
+  CVOP(MUL,  a = *sp++ *  a) \
+  CVOP(DIV,  a = *sp++ /  a) \
+  CVOP(MOD,  a = *sp++ %  a) \
+  CVOP(NOT,  a = ~*sp++) \
+  CVOP(NEG,  a = -a) \
+  CVOP(EQZ,  a = !a) \
+  CVOP(OPEN, a = open((char *)sp[1], *sp)) \
+  CVOP(READ, COSW(corw(sp[2], (char *)sp[1], *sp, 0, 1))) \
+  CVOP(WRIT, COSW(corw(sp[2], (char *)sp[1], *sp, 1, 1))) \
+  CVOP(CLOS, a = coclose(*sp)) \
+  CVOP(PRTF, t = sp + (*(unsigned char *)pc != CW(ADJ, 0) ? *(signed *)(pc + 1) : ((signed char *)pc)[1]); /* the ADJ next */ \
+             a = ioprintf((char *)t[-1], t - 1)) \
+  CVOP(MALC, a = (int)malloc(*sp)) \
+  CVOP(FREE, free((void *)*sp)) \
+  CVOP(MSET, a = (int)memset((char *)sp[2], sp[1], *sp)) \
+  CVOP(MCMP, a = memcmp((char *)sp[2], (char *)sp[1], *sp)) \
+  CVOP(SPWN, a = cxspawn(x, sp[1], *sp)) \
+  CVOP(YLD,  COSW(coyield())) \
+  CVOP(JOIN, COSW(cojoin(*sp, 0))) \
+  CVOP(GETC, COSW(iogetc(1))) \
+  CVOP(GETL, COSW(iogetl((char *)sp[1], *sp, 1))) \
+  CVOP(EXIT, if (cocur) { COSW(coend(*sp)); } else { printf("exit(%d) cycle = %d\n", *sp, cycle); return *sp; })
+#define CVMOPD \
+  CVOPD(IMM,  a = (int)(d + k)) \
+  CVOPD(ADDI, a = a + (int)(d + k))
+
+// d is the data of the instance run, x its context
+static int runcb(char *pc, int *bp, int *sp, char *d, int *x)
+{
+  int a, k, *t, cycle;
+#ifdef __GNUC__
+  void *lab[256];
+
+#define CVOP(o, ...) lab[CN(o)] = &&L_##o;
+#define CVOPK(o, ...) lab[CW(o, 0)] = &&L0_##o; lab[CW(o, 1)] = &&L1_##o; lab[CW(o, 2)] = &&L2_##o;
+#define CVOPD(o, ...) lab[CW(o, 3)] = &&L3_##o;
+  CVMOPS
+  CVMOPD
+#undef CVOP
+#undef CVOPK
+#undef CVOPD
+  a = 0; cycle = 1; coinit(x[CxCstub]);
+  goto *lab[*(unsigned char *)pc];
+#define CVOP(o, ...) L_##o: ++pc; __VA_ARGS__; ++cycle; goto *lab[*(unsigned char *)pc];
+#define CVOPK(o, ...) L0_##o: CK(0); __VA_ARGS__; ++cycle; goto *lab[*(unsigned char *)pc]; \
+                      L1_##o: CK(1); __VA_ARGS__; ++cycle; goto *lab[*(unsigned char *)pc]; \
+                      L2_##o: CK(2); __VA_ARGS__; ++cycle; goto *lab[*(unsigned char *)pc];
+#define CVOPD(o, ...) L3_##o: CK(1); __VA_ARGS__; ++cycle; goto *lab[*(unsigned char *)pc];
+  CVMOPS
+  CVMOPD
+#undef CVOP
+#undef CVOPK
+#undef CVOPD
+#else
+  a = cycle = 0; coinit(x[CxCstub]);
+  while (1) {
+    ++cycle;
+    switch (*(unsigned char *)pc) {
+#define CVOP(o, ...) case CN(o): ++pc; __VA_ARGS__; break;
+#define CVOPK(o, ...) case CW(o, 0): CK(0); __VA_ARGS__; break; \
+                      case CW(o, 1): CK(1); __VA_ARGS__; break; \
+                      case CW(o, 2): CK(2); __VA_ARGS__; break;
+#define CVOPD(o, ...) case CW(o, 3): CK(1); __VA_ARGS__; break;
+    CVMOPS
+    CVMOPD
+#undef CVOP
+#undef CVOPK
+#undef CVOPD
+    default: printf("unknown compact instruction = %d! cycle = %d\n", *(unsigned char *)pc, cycle); return -1;
+    }
+  }
+#endif
+}
+#undef CK
+
+// put context x in the compiler's globals
+static void cxload(int *x)
+{
+  cx = x;
+  sym = (int *)x[CxSym]; symh = (int *)x[CxSymh]; symhm = x[CxSymhm]; nsym = x[CxNsym];
+  strh = (int *)x[CxStrh]; strhm = x[CxStrhm]; nstr = x[CxNstr];
+  text = (int *)x[CxText]; le = e = (int *)x[CxE];
+  data0 = (char *)x[CxData0]; data = (char *)x[CxData]; rodat0 = (char *)x[CxRo0]; rodata = (char *)x[CxRo];
+  rsec = (int *)x[CxRsec]; ctext = (char *)x[CxCtext]; cmap = (int *)x[CxCmap]; cstub = (char *)x[CxCstub];
+}
+
+// and take it back
+static void cxsave(int *x)
+{
+  x[CxSym] = (int)sym; x[CxSymh] = (int)symh; x[CxSymhm] = symhm; x[CxNsym] = nsym;
+  x[CxStrh] = (int)strh; x[CxStrhm] = strhm; x[CxNstr] = nstr;
+  x[CxText] = (int)text; x[CxE] = (int)e;
+  x[CxData0] = (int)data0; x[CxData] = (int)data; x[CxRo0] = (int)rodat0; x[CxRo] = (int)rodata;
+  x[CxRsec] = (int)rsec; x[CxCtext] = (int)ctext; x[CxCmap] = (int)cmap; x[CxCstub] = (int)cstub;
+}
+
+// make the compact code of the program in x, once, and seal its rodata
+static int cxprep(int *x)
+{
+  int r;
+
+  pthread_mutex_lock(&cxm);
+  r = 0;
+  if (!x[CxPc]) { printf("no program compiled\n"); r = -1; }
+  else if (!x[CxCtext]) {
+    cxload(x);
+    if ((r = compact()) < 0) { free(ctext); free(cmap); ctext = 0; cmap = 0; }
+    else seal(rodat0, rodata);
+    cxsave(x);
+  }
+  pthread_mutex_unlock(&cxm);
+  return r;
+}
+
+// VM instances: the compiled program, as compact code, is shared read-only by
+// any number of instances, each with globals and a stack of its own, so they
+// can run on different threads at once: compile once, then instantiate and
+// run as often as needed
+enum { VmCx, VmData, VmStack, VmSize, Vmsz };
+
+#define VMSTACK (64*1024*1024) // stack of each instance, committed as touched
+
+// a new instance of the program in x: its globals, a guard page and its stack
+// in one mapping
+int *vmnew(int *x)
+{
+  int *vm, n;
+  char *m;
+
+  if (cxprep(x) < 0) return 0;
+  n = (x[CxData] - x[CxData0] + 4095) & -4096;
+  if (!(vm = malloc(Vmsz * sizeof(int)))) return 0;
+  m = mmap(0, n + 4096 + VMSTACK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (m == MAP_FAILED) { free(vm); return 0; }
+  mprotect(m + n, 4096, PROT_NONE);
+  vm[VmCx] = (int)x; vm[VmData] = (int)m; vm[VmStack] = (int)m + n + 4096 + VMSTACK; vm[VmSize] = n + 4096 + VMSTACK;
+  return vm;
+}
+
+void vmfree(int *vm) { munmap((char *)vm[VmData], vm[VmSize]); free(vm); }
+
+// run main in instance vm, with its globals zeroed first
+int vmrun(int *vm, int argc, char **argv)
+{
+  int *x, *sp;
+
+  x = (int *)vm[VmCx];
+  memset((char *)vm[VmData], 0, x[CxData] - x[CxData0]);
+  sp = (int *)vm[VmStack];
+  *--sp = argc;
+  *--sp = (int)argv;
+  *--sp = x[CxCstub];
+  return runcb((char *)x[CxCtext] + ((int *)x[CxCmap])[(int *)x[CxPc] - (int *)x[CxText]], (int *)vm[VmStack], sp, (char *)vm[VmData], x);
+}
+
+// work-stealing pool (-P): each worker owns a deque of run numbers, takes from
+// its back and, once that is empty, steals from the front of another's
+static int *pq,      // run numbers, the workers' deques side by side
+    *pqr,     // front and back of each deque in pq
+    *pres,    // exit code of each run
+    pargc,    // arguments of every run
+    pruns,    // runs to make (-P)
+    npool,    // workers (-P runs:workers, else one per online cpu)
+    nsteal;   // runs taken from another worker's deque
+static char **pargv;
+static pthread_mutex_t *pqm; // guards each deque
+
+static void *worker(void *arg)
+{
+  int w, v, r, *vm;
+
+  w = (int)arg;
+  if (!(vm = vmnew(cx))) { printf("could not map vm instance\n"); return 0; } // the others steal its runs
+  while (1) {
+    r = -1;
+    pthread_mutex_lock(pqm + w);
+    if (pqr[w * 2] < pqr[w * 2 + 1]) r = pq[--pqr[w * 2 + 1]];
+    pthread_mutex_unlock(pqm + w);
+    v = (w + 1) % npool;
+    while (r < 0 && v != w) {
+      pthread_mutex_lock(pqm + v);
+      if (pqr[v * 2] < pqr[v * 2 + 1]) { r = pq[pqr[v * 2]++]; __sync_fetch_and_add(&nsteal, 1); }
+      pthread_mutex_unlock(pqm + v);
+      v = (v + 1) % npool;
+    }
+    if (r < 0) break; // every deque is empty, and runs are only added up front
+    pres[r] = vmrun(vm, pargc, pargv);
+  }
+  vmfree(vm);
+  return 0;
+}
+
+// make pruns runs of the program on npool threads; the first failing run's
+// exit code, else 0
+static int pool(int argc, char **argv)
+{
+  pthread_t *th;
+  struct timespec t0, t1;
+  int i, r;
+
+  if (debug || hist) { printf("-P does not trace or profile\n"); return -1; }
+  if (cxprep(cx) < 0) return -1;
+  if (npool < 1) npool = sysconf(_SC_NPROCESSORS_ONLN);
+  if (npool > pruns) npool = pruns;
+  pq = malloc(pruns * sizeof(int)); pres = malloc(pruns * sizeof(int));
+  pqr = malloc(npool * 2 * sizeof(int)); pqm = malloc(npool * sizeof(pthread_mutex_t)); th = malloc(npool * sizeof(pthread_t));
+  if (!pq || !pres || !pqr || !pqm || !th) { printf("could not malloc pool\n"); return -1; }
+  pargc = argc; pargv = argv;
+  i = 0; while (i < pruns) { pq[i] = i; pres[i] = -1; ++i; }
+  i = 0;
+  while (i < npool) {
+    pqr[i * 2] = pruns * i / npool; pqr[i * 2 + 1] = pruns * (i + 1) / npool;
+    pthread_mutex_init(pqm + i, 0);
+    ++i;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  i = 0;
+  while (i < npool) { if (pthread_create(th + i, 0, worker, (void *)i)) { printf("could not start worker %d\n", i); exit(-1); } ++i; }
+  i = 0; while (i < npool) pthread_join(th[i++], 0);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  if (stats) printf("pool: %d runs, %d workers, %d stolen, %d us\n", pruns, npool, nsteal,
+    (int)((t1.tv_sec - t0.tv_sec) * 1000000 + (t1.tv_nsec - t0.tv_nsec) / 1000));
+  r = 0; i = 0;
+  while (i < pruns && !r) r = pres[i++];
+  return r;
+}
+
+// x86-64 JIT (-j): every VM instruction becomes a fixed native sequence. The VM
+// stack is the native stack (rsp = sp, rbp = bp, rax = a), so JSR and LEV are
+// call and ret, and frames, arguments and return words keep their layout
+static char *jcode, // native code, entered at its start as jcode(target, bp, sp)
+     *jc,    // next byte to emit
+     *jout,  // leave the native code with *sp as the exit code
+     *jret;  // where main returns to: PSH; EXIT
+static int *jmap,   // native offset of each text word that starts an instruction, else -1
+    jrsp,    // host stack pointer saved on entry
+    aotd;    // where -o places the data section (rodata at AOTRO, code at AOTTEXT)
+
+#define AOTBASE 0x400000   // executable layout: headers, then code, one page in
+#define AOTTEXT 0x401000
+#define AOTRO   0x10000000 // rodata, then data and the break state above it
+
+static int hexd(int c) { return c <= '9' ? c - '0' : (c | 32) - 'a' + 10; }
+
+// emit bytes written as hex pairs
+static void jx(char *s)
+{
+  while (*s) {
+    if (*s == ' ') ++s;
+    else { *jc++ = hexd(*s) * 16 + hexd(s[1]); s = s + 2; }
+  }
+}
+
+static void jd(int x) { *jc++ = x; *jc++ = x >> 8; *jc++ = x >> 16; *jc++ = x >> 24; }
+static void jq(int x) { jd(x); jd(x >> 32); }
+static int jfit(int x) { return x >= -2147483647 - 1 && x <= 2147483647; }
+
+// load sp[i] into argument register r (rdi 7, rsi 6, rdx 2, rcx 1, r8 8, r9 9)
+static void jarg(int r, int i)
+{
+  *jc++ = r >= 8 ? 0x4d : 0x49; *jc++ = 0x8b; *jc++ = 0x84 | (r & 7) << 3; *jc++ = 0x24; jd(i * 8);
+}
+
+// call a host function with rsp aligned (r12 keeps the VM sp); varargs callees need al = 0
+static void jcall(void *f, int va)
+{
+  if (va) jx("31 c0");
+  jx("49 bb"); jq((int)f); jx("41 ff d3 4c 89 e4");
+}
+
+// where -o places address k in section s
+static int jrel(int k, int s)
+{
+  if (!aot) return k;
+  if (s == RelRo) return k - (int)rodat0 + AOTRO;
+  if (s == RelData) return k - (int)data0 + aotd;
+  return k;
+}
+
+// a = a / d (or a % d) for a constant d, |d| > 1, by a multiply with its
+// magic number (Hacker's Delight 10-1) instead of a divide
+static void jdivk(int d, int mod)
+{
+  unsigned long long ad, anc, t, q1, r1, q2, r2, dl;
+  int p, m;
+
+  ad = d < 0 ? -d : d; t = (1ULL << 63) + ((unsigned long long)d >> 63);
+  anc = t - 1 - t % ad; p = 63;
+  q1 = (1ULL << 63) / anc; r1 = (1ULL << 63) - q1 * anc;
+  q2 = (1ULL << 63) / ad; r2 = (1ULL << 63) - q2 * ad;
+  do {
+    ++p;
+    q1 = 2 * q1; r1 = 2 * r1; if (r1 >= anc) { ++q1; r1 = r1 - anc; }
+    q2 = 2 * q2; r2 = 2 * r2; if (r2 >= ad) { ++q2; r2 = r2 - ad; }
+    dl = ad - r2;
+  } while (q1 < dl || (q1 == dl && !r1));
+  m = q2 + 1; if (d < 0) m = -m;
+  jx("48 89 c1 48 ba"); jq(m); jx("48 f7 ea");   // rdx = the high half of a * m
+  if (d > 0 && m < 0) jx("48 01 ca"); else if (d < 0 && m > 0) jx("48 29 ca");
+  if (p > 64) { jx("48 c1 fa"); *jc++ = p - 64; }
+  jx("48 89 d0 48 c1 ea 3f 48 01 d0");           // rounded towards zero
+  if (mod) { jx("48 ba"); jq(d); jx("48 0f af c2 48 29 c1 48 89 c8"); }
+}
+
+// a overwritten by the instruction at q without being read
+static int jkill(int *q) { return q > text && q <= e && (*q == LEA || *q == IMM || *q == LL || *q == LG); }
+
+// set the rel8 jump ending at j to here
+static void jhere(char *j) { j[-1] = jc - j; }
+
+// translate the whole text; 0 if some instruction has no translation, and the
+// program then runs on the interpreter. With -o the code is an executable's,
+// entered at main (pm) with its own stack, and the system calls are raw ones
+// or the runtime's
+static int jit(int *pm)
+{
+  int *pc, *fix, nfix, o, k, i, *pf, *mf, *ff, *gf, *lf, *ef, *rf;
+  char *c, *sb, *j1, *j2, *j3;
+
+  jmap = (int *)malloc((e - text + 2) * sizeof(int));
+  fix = (int *)malloc((e - text + 2) * sizeof(int));
+  if (!jmap || !fix) { printf("could not malloc jit maps\n"); exit(-1); }
+  memset(jmap, -1, (e - text + 2) * sizeof(int));
+  jc = jcode; nfix = 0;
+  pf = mf = ff = gf = lf = ef = rf = 0; sb = 0; // the runtime's, set only with -o
+  if (aot) {
+    pf = (int *)rtfun("__printf"); mf = (int *)rtfun("__malloc"); ff = (int *)rtfun("__free");
+    gf = (int *)rtfun("__getc"); lf = (int *)rtfun("__getl");
+    ef = (int *)rtfun("__flush"); rf = (int *)rtfun("__iflush");
+    jx("b8 10 00 00 00 bf 01 00 00 00 be 01 54 00 00 48 8d 54 24 c0 0f 05"); // __tty = !ioctl(1, TCGETS, ...)
+    jx("85 c0 0f 94 c0 48 0f b6 c0 48 a3"); jq(jrel(rtfun("__tty"), RelData));
+    jx("49 89 e4 b8 09 00 00 00 31 ff be"); jd(256*1024*1024);  // mmap the stack,
+    jx("ba 03 00 00 00 41 ba 22 40 00 00 49 c7 c0 ff ff ff ff 45 31 c9 0f 05 48 8d a0"); jd(256*1024*1024);
+    jx("48 89 c7 be 00 10 00 00 31 d2 b8 0a 00 00 00 0f 05");   // a guard page below it
+    jx("6a 00 6a 00 41 ff 34 24 49 8d 44 24 08 50 e8");         // argc and argv, as run() does
+    fix[nfix++] = jc - jcode; fix[nfix++] = (int)pm; jd(0);
+    jx("50");
+    jout = jc;
+    jx("e8"); fix[nfix++] = jc - jcode; fix[nfix++] = (int)ef; jd(0);
+    jx("48 8b 3c 24 b8 e7 00 00 00 0f 05");                     // exit_group(*sp) once stdout is out
+    sb = jc;                                                    // sbrk(rdi), state past data
+    jx("48 b9"); jq(aotd + ((data - data0 + 7) & -8));
+    jx("48 8b 01 48 85 c0 75 00"); j1 = jc;
+    jx("57 51 31 ff b8 0c 00 00 00 0f 05 59 5f 48 83 c0 0f 48 83 e0 f0 48 89 01 48 89 41 08");
+    jhere(j1);
+    jx("48 8d 54 38 0f 48 83 e2 f0 48 3b 51 08 76 00"); j2 = jc;
+    jx("50 51 52 48 8d ba ff ff 0f 00 48 81 e7 00 00 f0 ff b8 0c 00 00 00 0f 05 5a 59 48 39 d0 72 00"); j3 = jc;
+    jx("48 89 41 08 58");
+    jhere(j2);
+    jx("48 89 11 c3");
+    jhere(j3);
+    jx("58 31 c0 c3");
   }
   else {
-    expr(Assign);
-    if (tk == ';') next(); else { printf("%d: semicolon expected\n", line); exit(-1); }
+    jx("53 55 41 54 41 55 41 56 41 57 48 b9"); jq((int)&jrsp); // save host registers and stack,
+    jx("48 89 21 48 89 f5 48 89 d4 31 c0 ff e7");              // take bp and sp, jump to target
+    jout = jc;
+    jx("48 8b 04 24 48 b9"); jq((int)&jrsp);
+    jx("48 8b 21 41 5f 41 5e 41 5d 41 5c 5d 5b c3");
+    jret = jc;
+    jx("50 e9"); jd(jout - jc - 4);
+  }
+
+  pc = text + 1;
+  while (pc <= e) {
+    jmap[pc - text] = jc - jcode;
+    o = *pc++; k = 0;
+    if (o <= ADJ) k = *pc++;
+    if (o == IMM || o == ADDI || o == LG || o == SG) k = jrel(k, rsec[pc - 1 - text]);
+    if (o == LEA) { jx("48 8d 85"); jd(k * 8); }
+    else if (o == IMM) { if (jfit(k)) { jx("48 c7 c0"); jd(k); } else { jx("48 b8"); jq(k); } }
+    else if (o == JMP || o == JSR || o == BZ || o == BNZ) {
+      if (o == JMP) jx("e9"); else if (o == JSR) jx("e8");
+      else if (o == BZ) jx("48 85 c0 0f 84"); else jx("48 85 c0 0f 85");
+      fix[nfix++] = jc - jcode; fix[nfix++] = k; jd(0);
+    }
+    else if (o >= EQBZ && o <= GEBZ) { // a = the compare only where someone reads it
+      i = hexd("45cfed"[o - EQBZ]);
+      if (jkill(pc) && jkill((int *)k)) jx("59 48 39 c1");
+      else { jx("59 31 d2 48 39 c1 0f"); *jc++ = 0x90 | i; jx("c2 48 89 d0"); }
+      *jc++ = 0x0f; *jc++ = 0x80 | i ^ 1;
+      fix[nfix++] = jc - jcode; fix[nfix++] = k; jd(0);
+    }
+    else if (o == ENT) { jx("55 48 89 e5"); if (k) { jx("48 81 ec"); jd(k * 8); } }
+    else if (o == ADDI) { if (jfit(k)) { jx("48 05"); jd(k); } else { jx("48 b9"); jq(k); jx("48 01 c8"); } }
+    else if (o == MULI) { if (jfit(k)) { jx("48 69 c0"); jd(k); } else { jx("48 b9"); jq(k); jx("48 0f af c1"); } }
+    else if ((o == DIVI || o == MODI) && k != (1LL << 63) && (k > 1 || k < -1)) jdivk(k, o == MODI);
+    else if (o == DIVI || o == MODI) { jx("48 b9"); jq(k); jx("48 99 48 f7 f9"); if (o == MODI) jx("48 89 d0"); }
+    else if (o == DIVS || o == MODS) { // a plus 2^k - 1 if negative, shifted or masked
+      jx("48 89 c1 48 c1 f9 3f 48 c1 e9"); *jc++ = 64 - k;
+      if (o == DIVS) { jx("48 01 c8 48 c1 f8"); *jc++ = k; }
+      else { jx("48 8d 14 08 48 b9"); jq(-(1LL << k)); jx("48 21 ca 48 29 d0"); }
+    }
+    else if (o == SHLI) { jx("48 c1 e0"); *jc++ = k; }
+    else if (o == SHRI) { jx("48 c1 f8"); *jc++ = k; }
+    else if (o == LL) { jx("48 8b 85"); jd(k * 8); }
+    else if (o == LG) { jx("48 a1"); jq(k); }
+    else if (o == SL) { jx("48 89 85"); jd(k * 8); }
+    else if (o == SG) { jx("48 a3"); jq(k); }
+    else if (o == TSR) {
+      i = 0;
+      while (i < k) { jx("48 8b 8c 24"); jd(i * 8); jx("48 89 8d"); jd(16 + i * 8); ++i; }
+      jx("48 8d 65 08 48 8b 6d 00");
+    }
+    else if (o == ADJ) { jx("48 81 c4"); jd(k * 8); }
+    else if (o == LEV) jx("48 89 ec 5d c3");
+    else if (o == LI) jx("48 8b 00");
+    else if (o == LC) jx("48 0f be 00");
+    else if (o == SI) jx("59 48 89 01");
+    else if (o == SC) jx("59 88 01 48 0f be c0");
+    else if (o == PSH) jx("50");
+    else if (o == OR) jx("59 48 09 c8");
+    else if (o == XOR) jx("59 48 31 c8");
+    else if (o == AND) jx("59 48 21 c8");
+    else if (o >= EQ && o <= GE) { jx("59 48 39 c1 0f"); *jc++ = 0x90 | hexd("45cfed"[o - EQ]); jx("c0 0f b6 c0"); }
+    else if (o == SHL) jx("48 89 c1 58 48 d3 e0");
+    else if (o == SHR) jx("48 89 c1 58 48 d3 f8");
+    else if (o == ADD) jx("59 48 01 c8");
+    else if (o == SUB) jx("59 48 29 c1 48 89 c8");
+    else if (o == MUL) jx("59 48 0f af c1");
+    else if (o == DIV) jx("48 89 c1 58 48 99 48 f7 f9");
+    else if (o == MOD) jx("48 89 c1 58 48 99 48 f7 f9 48 89 d0");
+    else if (o == NOT) jx("58 48 f7 d0");
+    else if (o == NEG) jx("48 f7 d8");
+    else if (o == EQZ) jx("48 85 c0 0f 94 c0 0f b6 c0");
+    else if (aot && o >= OPEN && o <= CLOS) { // raw system calls, failing with -1 as libc does
+      if ((o == READ || o == WRIT) && pc <= rt0) { // after what printf holds
+        jx("e8"); fix[nfix++] = jc - jcode; fix[nfix++] = (int)(o == READ ? rf : ef); jd(0);
+      }
+      jx("49 89 e4");
+      if (o == OPEN) { jarg(7, 1); jarg(6, 0); jx("ba b6 01 00 00 b8 02 00 00 00"); }
+      else if (o == CLOS) { jarg(7, 0); jx("b8 03 00 00 00"); }
+      else { jarg(7, 2); jarg(6, 1); jarg(2, 0); jx(o == READ ? "31 c0" : "b8 01 00 00 00"); }
+      jx("0f 05 48 85 c0 79 07 48 c7 c0 ff ff ff ff");
+    }
+    else if (aot && (o == GETC || o == GETL)) { // the arguments are where the runtime's take them
+      jx("e8"); fix[nfix++] = jc - jcode; fix[nfix++] = (int)(o == GETC ? gf : lf); jd(0);
+    }
+    else if (aot && (o == PRTF || o == MALC || o == FREE)) {
+      if (o == MALC && pc > rt0) { jx("48 8b 3c 24 e8"); jd(sb - jc - 4); } // the runtime's own, from the break
+      else {
+        if (o == PRTF) {
+          if (pc > e || *pc != ADJ) return 0;
+          jx("48 8d 8c 24"); jd(pc[1] * 8); jx("51");
+        }
+        if (o == FREE) jx("49 89 c5");
+        jx("e8"); fix[nfix++] = jc - jcode; fix[nfix++] = (int)(o == PRTF ? pf : o == MALC ? mf : ff); jd(0);
+        if (o == PRTF) jx("59");
+        if (o == FREE) jx("4c 89 e8");
+      }
+    }
+    else if (aot && o == MSET) { jx("49 89 e4"); jarg(7, 2); jarg(0, 1); jarg(1, 0); jx("48 89 fa f3 aa 48 89 d0"); }
+    else if (aot && o == MCMP) { jx("49 89 e4"); jarg(6, 2); jarg(7, 1); jarg(1, 0); jx("31 c0 48 85 c9 74 0d f3 a6 0f b6 46 ff 0f b6 4f ff 48 29 c8"); }
+    else if (o == GETC || o == GETL) {
+      jx("49 89 e4 48 83 e4 f0");
+      if (o == GETC) jcall(jgetc, 0); else { jarg(7, 1); jarg(6, 0); jcall(jgetl, 0); }
+    }
+    else if (o >= OPEN && o <= MCMP) {
+      jx("49 89 e4 48 83 e4 f0");
+      if (o == OPEN) { jarg(7, 1); jarg(6, 0); jcall(open, 1); jx("48 63 c0"); }
+      else if (o == READ) { jarg(7, 2); jarg(6, 1); jarg(2, 0); jx("31 c9"); jcall(jrw, 0); }
+      else if (o == WRIT) { jarg(7, 2); jarg(6, 1); jarg(2, 0); jx("b9 01 00 00 00"); jcall(jrw, 0); }
+      else if (o == CLOS) { jarg(7, 0); jcall(close, 0); jx("48 63 c0"); }
+      else if (o == PRTF) { // the argument count is in the ADJ that follows
+        if (pc > e || *pc != ADJ) { if (stats) printf("jit: PRTF without ADJ at %d, interpreting\n", (int)(pc - text)); return 0; }
+        k = pc[1];
+        jarg(7, k - 1); jx("49 8d b4 24"); jd((k - 1) * 8);
+        jcall(ioprintf, 0);
+      }
+      else if (o == MALC) { jarg(7, 0); jcall(malloc, 0); }
+      else if (o == FREE) { jx("49 89 c5"); jarg(7, 0); jcall(free, 0); jx("4c 89 e8"); }
+      else if (o == MSET) { jarg(7, 2); jarg(6, 1); jarg(2, 0); jcall(memset, 0); }
+      else { jarg(7, 2); jarg(6, 1); jarg(2, 0); jcall(memcmp, 0); jx("48 63 c0"); }
+    }
+    else if (o == EXIT) { jx("e9"); jd(jout - jc - 4); }
+    else { if (stats) printf("jit: no translation for %d at %d, interpreting\n", o, (int)(pc - text - 1)); return 0; }
+  }
+
+  i = 0;
+  while (i < nfix) { // branch targets
+    o = fix[i++]; k = (int *)fix[i++] - text;
+    if (k < 1 || k > e - text || jmap[k] < 0) {
+      if (stats) printf("jit: branch into no instruction at %d, interpreting\n", k);
+      return 0;
+    }
+    c = jc; jc = jcode + o; jd(jmap[k] - o - 4); jc = c;
   }
+  free(fix);
+  if (aot) return 1;
+  if (mprotect(jcode, (jc - jcode + 4095) & -4096, PROT_READ | PROT_EXEC)) { printf("could not map jit code executable\n"); exit(-1); }
+  if (stats) printf("jit: %d words -> %d bytes\n", (int)(e - text), (int)(jc - jcode));
+  return 1;
 }
 
-int main(int argc, char **argv)
+static void jw(int x) { *jc++ = x; *jc++ = x >> 8; }
+
+// one program header: type, flags, file offset, address, file and memory size
+static void elfph(int t, int f, int o, int v, int fs, int ms)
 {
-  int fd, bt, ty, poolsz, *idmain;
-  int *pc, *sp, *bp, a, cycle; // vm registers
-  int i, *t; // temps
+  jd(t); jd(f); jq(o); jq(v); jq(v); jq(fs); jq(ms); jq(4096);
+}
 
-  --argc; ++argv;
-  if (argc > 0 && **argv == '-' && (*argv)[1] == 's') { src = 1; --argc; ++argv; }
-  if (argc > 0 && **argv == '-' && (*argv)[1] == 'd') { debug = 1; --argc; ++argv; }
-  if (argc < 1) { printf("usage: c4 [-s] [-d] file ...\n"); return -1; }
+// -o: write the translated code as a static x86-64 executable; one segment
+// each for the code, rodata and data (which the file does not hold)
+static int elfout()
+{
+  char *h, *c;
+  int fd, n, ro, rsz, dsz;
+
+  n = jc - jcode; c = jc;
+  if (AOTTEXT + n > AOTRO) { printf("code too large for an executable\n"); return -1; }
+  ro = (0x1000 + n + 4095) & -4096; rsz = rodata - rodat0;
+  dsz = aotd + ((data - data0 + 7) & -8) + 16 - aotd; // and the break state
+  if (!(h = malloc(4096))) { printf("could not malloc elf header\n"); return -1; }
+  memset(h, 0, 4096);
+  jc = h;
+  jx("7f 45 4c 46 02 01 01 00 00 00 00 00 00 00 00 00");   // ELF64, little endian
+  jw(2); jw(0x3e); jd(1); jq(AOTTEXT); jq(64); jq(0); jd(0); // executable, x86-64, entry, phoff
+  jw(64); jw(56); jw(4); jw(64); jw(0); jw(0);
+  elfph(1, 5, 0, AOTBASE, 0x1000 + n, 0x1000 + n);
+  elfph(1, 4, ro, AOTRO, rsz, rsz);
+  elfph(1, 6, ro + ((rsz + 4095) & -4096), aotd, 0, dsz);
+  elfph(0x6474e551, 6, 0, 0, 0, 0);                          // PT_GNU_STACK: not executable
+  jc = c;
+  if ((fd = open(aotout, O_WRONLY | O_CREAT | O_TRUNC, 0755)) < 0) { printf("could not open(%s)\n", aotout); return -1; }
+  if (write(fd, h, 4096) != 4096 || write(fd, jcode, n) != n ||
+      (rsz && (lseek(fd, ro, SEEK_SET) != ro || write(fd, rodat0, rsz) != rsz))) {
+    printf("could not write %s\n", aotout); close(fd); return -1;
+  }
+  close(fd);
+  free(h);
+  if (stats) printf("aot: %d bytes code, %d rodata, %d data -> %s\n", n, rsz, (int)(data - data0), aotout);
+  return 0;
+}
+
+// compiled-image cache: the text with its absolute operands made relative and
+// listed for relocation, plus rodata, saved under a hash of the source, the
+// compiler build and the options that change code. A warm start maps the
+// image and relocates it into the arenas instead of compiling
+#define IMVER "c4 image 1, " __DATE__ " " __TIME__
+#define IMMAGIC 0x676d693463 // "c4img"
+
+enum { ImMagic, ImKey, ImText, ImRel, ImRo, ImData, ImMain, Imsz };
+
+static char impath[4096]; // image file for this source
+static int imkey;
+
+// key the source s..t and choose its image file under the cache directory
+static int imhash(char *s, char *t)
+{
+  char *v, *d;
+
+  imkey = -3750763034362895579; // FNV-1a
+  while (s < t) imkey = (imkey ^ (*s++ & 255)) * 1099511628211;
+  v = IMVER; while (*v) imkey = (imkey ^ *v++) * 1099511628211;
+  imkey = (((imkey ^ opt) * 1099511628211 ^ inl) * 1099511628211 ^ loopt) * 1099511628211;
+  if ((d = getenv("XDG_CACHE_HOME")) && *d) v = "";
+  else if ((d = getenv("HOME")) && *d) v = "/.cache";
+  else return 0;
+  if (strlen(d) > sizeof(impath) - 64) return 0;
+  sprintf(impath, "%s%s", d, v); mkdir(impath, 0755);
+  sprintf(impath, "%s%s/c4", d, v); mkdir(impath, 0755);
+  sprintf(impath, "%s%s/c4/%016llx.img", d, v, imkey);
+  return 1;
+}
+
+// relocate a valid image into the arenas; main, or 0 to compile instead
+static int *imload()
+{
+  struct stat st;
+  int fd, *h, *w, *r, n, i, k;
+
+  if ((fd = open(impath, 0)) < 0) return 0;
+  if (fstat(fd, &st) || st.st_size < Imsz * sizeof(int) ||
+      (h = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) { close(fd); return 0; }
+  close(fd);
+  n = h[ImText];
+  if (h[ImMagic] != IMMAGIC || h[ImKey] != imkey || n < 1 || h[ImRel] < 0 || h[ImRo] < 0 || h[ImData] < 0 ||
+      h[ImMain] < 1 || h[ImMain] > n || (Imsz + n + h[ImRel]) * sizeof(int) + h[ImRo] != st.st_size) {
+    munmap(h, st.st_size); return 0;
+  }
+  w = h + Imsz; r = w + n;
+  i = 0;
+  while (i < h[ImRel]) if ((k = r[i++] >> 2) < 1 || k > n || !(r[i - 1] & 3)) { munmap(h, st.st_size); return 0; }
+  if (!(rsec = malloc((n + 2) * sizeof(int)))) { munmap(h, st.st_size); return 0; }
+  memset(rsec, 0, (n + 2) * sizeof(int));
+  memcpy(text + 1, w, n * sizeof(int)); e = text + n;
+  i = 0;
+  while (i < h[ImRel]) {
+    k = r[i++]; rsec[k >> 2] = k & 3;
+    text[k >> 2] = text[k >> 2] + ((k & 3) == RelText ? (int)text : (k & 3) == RelData ? (int)data0 : (int)rodat0);
+  }
+  memcpy(rodata, r + h[ImRel], h[ImRo]); rodata = rodata + h[ImRo];
+  data = data + h[ImData];
+  w = text + h[ImMain];
+  munmap(h, st.st_size);
+  return w;
+}
+
+// write the image of the compiled program (main at pc), replacing any other atomically
+static void imsave(int *pc)
+{
+  char tmp[4096 + 32];
+  int fd, *h, *w, *r, n, m, o, k, i;
+
+  n = e - text;
+  if (!(h = malloc((Imsz + 2 * n) * sizeof(int)))) return;
+  w = h + Imsz; r = w + n;
+  memcpy(w, text + 1, n * sizeof(int));
+  m = 0; i = 1;
+  while (i <= n) {
+    if (o = rsec[i]) {
+      w[i - 1] = text[i] - (o == RelText ? (int)text : o == RelData ? (int)data0 : (int)rodat0);
+      r[m++] = i << 2 | o;
+    }
+    ++i;
+  }
+  h[ImMagic] = IMMAGIC; h[ImKey] = imkey; h[ImText] = n; h[ImRel] = m;
+  h[ImRo] = rodata - rodat0; h[ImData] = data - data0; h[ImMain] = pc - text;
+  sprintf(tmp, "%s.%d", impath, (int)getpid());
+  if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) { free(h); return; }
+  k = (Imsz + n + m) * sizeof(int);
+  o = write(fd, h, k) == k && write(fd, rodat0, h[ImRo]) == h[ImRo];
+  if (close(fd) || !o || rename(tmp, impath)) unlink(tmp);
+  else if (stats) printf("cache: wrote %s, %d words, %d relocations\n", impath, n, m);
+  free(h);
+}
+
+// set up main's frame below sp and run the program from pc
+static int run(int *pc, int *sp, int argc, char **argv)
+{
+  int *bp, *t;
+
+  bp = sp;
+  *--sp = EXIT; // call exit if main returns
+  *--sp = PSH; t = sp;
+  *--sp = argc;
+  *--sp = (int)argv;
+  if (engine == 'r' && !debug && !hist) { *--sp = (int)re; return runrg((int *)rmap[pc - text], bp, sp); } // to RHALT
+  if (engine == 'c' && !debug && !hist) { *--sp = (int)cstub; return runcb(ctext + cmap[pc - text], bp, sp, data0, cx); }
+  if (engine == 'j') { // native code counts no cycles
+    *--sp = (int)jret;
+    t = (int *)((int (*)())jcode)(jcode + jmap[pc - text], bp, sp);
+    printf("exit(%d) cycle = 0\n", (int)t);
+    return (int)t;
+  }
+  *--sp = (int)t;
+  return (engine == 't' && !debug && !hist) ? runth(pc, bp, sp) : runsw(pc, bp, sp);
+}
+
+// fork server (-S): the compiled and prepared program waits on a Unix socket,
+// and each connection runs it in a forked copy-on-write child. The first line
+// a client sends holds the arguments after the program name; after that the
+// connection is the program's stdin and stdout
+#define SRVLAT 65536 // latencies kept, the latest ones
+
+static char *srvpath; // socket to serve on (-S)
+static int *srvlat,   // microseconds from accept to exit of each request, -1 until then; shared with the children
+    nsrv,      // requests accepted
+    srvstop;   // SIGINT or SIGTERM seen
+
+// libc calls these two back, so they take real ints
+#undef int
+static void srvsig(int sig) { srvstop = 1; }
+
+static int srvcmp(const void *x, const void *y) { return *(long long *)x < *(long long *)y ? -1 : *(long long *)x > *(long long *)y; }
+#define int long long
 
-  if ((fd = open(*argv, 0)) < 0) { printf("could not open(%s)\n", *argv); return -1; }
+static int serve(int *pc, int *sp, int argc, char **argv)
+{
+  struct sockaddr_un sa;
+  struct sigaction sg;
+  struct stat st;
+  struct timespec t0, t1;
+  char ln[4096], *av[64];
+  int ls, c, i, k, n, ac, *l;
+
+  if (strlen(srvpath) >= sizeof(sa.sun_path)) { printf("socket path too long: %s\n", srvpath); return -1; }
+  memset(&sa, 0, sizeof(sa));
+  sa.sun_family = AF_UNIX; strcpy(sa.sun_path, srvpath);
+  if (!lstat(srvpath, &st)) { // only ever replace a socket, left by an earlier run
+    if (!S_ISSOCK(st.st_mode)) { printf("%s is not a socket\n", srvpath); return -1; }
+    unlink(srvpath);
+  }
+  if ((ls = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 || bind(ls, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(ls, 128) < 0) {
+    printf("could not listen on %s\n", srvpath); return -1;
+  }
+  if ((srvlat = mmap(0, SRVLAT * sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+    printf("could not map latency table\n"); return -1;
+  }
+  memset(srvlat, -1, SRVLAT * sizeof(int));
+  memset(data0, 0, data - data0); sp[-1] = 0; // commit the globals and the stack top here, not in every child
+
+  memset(&sg, 0, sizeof(sg));
+  sg.sa_handler = srvsig; // no SA_RESTART: accept() returns on a stop
+  sigaction(SIGINT, &sg, 0); sigaction(SIGTERM, &sg, 0);
+  signal(SIGCHLD, SIG_IGN); // children reap themselves
+  printf("serving %s on %s\n", argv[0], srvpath); fflush(stdout);
+  while (!srvstop) {
+    if ((c = accept(ls, 0, 0)) < 0) continue;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    k = nsrv++ % SRVLAT; srvlat[k] = -1;
+    if ((i = fork()) < 0) { printf("could not fork request %d\n", nsrv); fflush(stdout); close(c); continue; }
+    if (i) { close(c); continue; }
+    signal(SIGINT, SIG_DFL); signal(SIGTERM, SIG_DFL);
+    close(ls); dup2(c, 0); dup2(c, 1); close(c);
+    n = 0; while (n < sizeof(ln) - 1 && read(0, ln + n, 1) == 1 && ln[n] != '\n') ++n; // one byte at a time: the rest is stdin
+    ln[n] = 0;
+    av[0] = argv[0]; ac = 1; i = 0;
+    while (ln[i] && ac < 63) {
+      while (ln[i] == ' ') ln[i++] = 0;
+      if (ln[i]) av[ac++] = ln + i;
+      while (ln[i] && ln[i] != ' ') ++i;
+    }
+    av[ac] = 0;
+    i = run(pc, sp, ac, av);
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    srvlat[k] = (t1.tv_sec - t0.tv_sec) * 1000000 + (t1.tv_nsec - t0.tv_nsec) / 1000;
+    _exit(i);
+  }
+  close(ls); unlink(srvpath);
 
-  poolsz = 256*1024; // arbitrary size
-  if (!(sym = malloc(poolsz))) { printf("could not malloc(%d) symbol area\n", poolsz); return -1; }
-  if (!(le = e = malloc(poolsz))) { printf("could not malloc(%d) text area\n", poolsz); return -1; }
-  if (!(data = malloc(poolsz))) { printf("could not malloc(%d) data area\n", poolsz); return -1; }
-  if (!(sp = malloc(poolsz))) { printf("could not malloc(%d) stack area\n", poolsz); return -1; }
+  n = 0; i = 0;
+  if (!(l = malloc(SRVLAT * sizeof(int)))) { printf("could not malloc latencies\n"); return -1; }
+  while (i < nsrv && i < SRVLAT) { if (srvlat[i] >= 0) l[n++] = srvlat[i]; ++i; }
+  qsort(l, n, sizeof(int), srvcmp);
+  printf("serve: %d requests, %d timed", nsrv, n);
+  if (n) printf(", p50 %d us, p90 %d us, p99 %d us, p99.9 %d us, max %d us", l[n * 50 / 100], l[n * 90 / 100], l[n * 99 / 100], l[n * 999 / 1000], l[n - 1]);
+  printf("\n");
+  return 0;
+}
+
+// prepare the chosen engine for the text and run (or serve) the program
+static int start(int *pc, int *sp, int argc, char **argv)
+{
+  if (pruns) return pool(argc, argv);
+  if (engine == 'r' && regs() < 0) return -1;
+  if (engine == 'c' && cxprep(cx) < 0) return -1;
+  if (engine == 'j' && (debug || hist || !jit(0))) engine = 't';
+  seal(rodat0, rodata);
+  return srvpath ? serve(pc, sp, argc, argv) : run(pc, sp, argc, argv);
+}
 
-  memset(sym,  0, poolsz);
-  memset(e,    0, poolsz);
-  memset(data, 0, poolsz);
+// a new context, with the keywords and the library in its symbol table. It
+// is left in the globals
+int *c4new()
+{
+  int *x, i;
+
+  if (!(x = malloc(Cxsz * sizeof(int)))) { printf("could not malloc context\n"); exit(-1); }
+  memset(x, 0, Cxsz * sizeof(int));
+  pthread_mutex_lock(&cxm);
+  cxload(x);
+  sym  = (int *)reserve(256*1024*1024, "symbol", 0, 0);
+  text = le = e = (int *)reserve(1024*1024*1024, "text", 0, hugepg);
+  data0 = data = reserve(1024*1024*1024, "data", 0, 0);
+  rodat0 = rodata = reserve(1024*1024*1024, "rodata", 0, 0);
+  symhm = 255;
+  if (!(symh = malloc((symhm + 1) * sizeof(int)))) { printf("could not malloc symbol hash\n"); exit(-1); }
+  memset(symh, 0, (symhm + 1) * sizeof(int));
+  strhm = 255;
+  if (!(strh = malloc((strhm + 1) * 2 * sizeof(int)))) { printf("could not malloc literal table\n"); exit(-1); }
+  memset(strh, 0, (strhm + 1) * 2 * sizeof(int));
 
+  lexinit();
   p = "char else enum if int return sizeof while "
-      "open read close printf malloc free memset memcmp exit void main";
+      "open read write close printf malloc free memset memcmp spawn yield join getchar getline exit void main";
+  pe = p + strlen(p);
   i = Char; while (i <= While) { next(); id[Tk] = i++; } // add keywords to symbol table
   i = OPEN; while (i <= EXIT) { next(); id[Class] = Sys; id[Type] = INT; id[Val] = i++; } // add library to symbol table
   next(); id[Tk] = Char; // handle void type
-  next(); idmain = id; // keep track of main
+  next(); x[CxMain] = (int)id; // keep track of main
+  cxsave(x);
+  pthread_mutex_unlock(&cxm);
+  return x;
+}
 
-  if (!(lp = p = malloc(poolsz))) { printf("could not malloc(%d) source area\n", poolsz); return -1; }
-  if ((i = read(fd, p, poolsz-1)) <= 0) { printf("read() returned %d\n", i); return -1; }
-  p[i] = 0;
-  close(fd);
+// compile the source s (NUL terminated) into the context in the globals;
+// where main starts, or 0 after reporting an error
+static int *compile(char *s)
+{
+  int bt, ty, i, *fs, *fn, *pc;
+  clock_t ct; // compile start
+
+  lp = p = s; pe = s + strlen(s);
+  nscope = bcx = 0; // an error in another compile can leave them set
+  if (cache) cache = !aot && imhash(p, pe);
+  if (cache && !src && !stats && (pc = imload())) return pc; // warm start
 
   // parse declarations
+  ct = clock();
   line = 1;
   next();
-  while (tk) {
+  while (tk || (aot == 1 && rtparse())) { // with -o, the runtime follows the program
     bt = INT; // basetype
     if (tk == Int) next();
     else if (tk == Char) { next(); bt = CHAR; }
@@ -383,11 +4020,11 @@ int main(int argc, char **argv)
         next();
         i = 0;
         while (tk != '}') {
-          if (tk != Id) { printf("%d: bad enum identifier %d\n", line, tk); return -1; }
+          if (tk != Id) { printf("%d: bad enum identifier %d\n", line, tk); return 0; }
           next();
           if (tk == Assign) {
             next();
-            if (tk != Num) { printf("%d: bad enum initializer\n", line); return -1; }
+            if (tk != Num) { printf("%d: bad enum initializer\n", line); return 0; }
             i = ival;
             next();
           }
@@ -400,30 +4037,28 @@ int main(int argc, char **argv)
     while (tk != ';' && tk != '}') {
       ty = bt;
       while (tk == Mul) { next(); ty = ty + PTR; }
-      if (tk != Id) { printf("%d: bad global declaration\n", line); return -1; }
-      if (id[Class]) { printf("%d: duplicate global definition\n", line); return -1; }
+      if (tk != Id) { printf("%d: bad global declaration\n", line); return 0; }
+      if (id[Class]) { printf("%d: duplicate global definition\n", line); return 0; }
       next();
       id[Type] = ty;
       if (tk == '(') { // function
-        id[Class] = Fun;
-        id[Val] = (int)(e + 1);
+        id[Class] = Fun; id[End] = 0;
+        id[Val] = (int)(fs = e + 1); fn = id;
         next(); i = 0;
         while (tk != ')') {
           ty = INT;
           if (tk == Int) next();
           else if (tk == Char) { next(); ty = CHAR; }
           while (tk == Mul) { next(); ty = ty + PTR; }
-          if (tk != Id) { printf("%d: bad parameter declaration\n", line); return -1; }
-          if (id[Class] == Loc) { printf("%d: duplicate parameter definition\n", line); return -1; }
-          id[HClass] = id[Class]; id[Class] = Loc;
-          id[HType]  = id[Type];  id[Type] = ty;
-          id[HVal]   = id[Val];   id[Val] = i++;
+          if (tk != Id) { printf("%d: bad parameter declaration\n", line); return 0; }
+          if (id[Class] == Loc) { printf("%d: duplicate parameter definition\n", line); return 0; }
+          local(ty, i++);
           next();
           if (tk == ',') next();
         }
         next();
-        if (tk != '{') { printf("%d: bad function definition\n", line); return -1; }
-        loc = ++i;
+        if (tk != '{') { printf("%d: bad function definition\n", line); return 0; }
+        fn[Arg] = i; loc = ++i;
         next();
         while (tk == Int || tk == Char) {
           bt = (tk == Int) ? INT : CHAR;
@@ -431,27 +4066,27 @@ int main(int argc, char **argv)
           while (tk != ';') {
             ty = bt;
             while (tk == Mul) { next(); ty = ty + PTR; }
-            if (tk != Id) { printf("%d: bad local declaration\n", line); return -1; }
-            if (id[Class] == Loc) { printf("%d: duplicate local definition\n", line); return -1; }
-            id[HClass] = id[Class]; id[Class] = Loc;
-            id[HType]  = id[Type];  id[Type] = ty;
-            id[HVal]   = id[Val];   id[Val] = ++i;
+            if (tk != Id) { printf("%d: bad local declaration\n", line); return 0; }
+            if (id[Class] == Loc) { printf("%d: duplicate local definition\n", line); return 0; }
+            local(ty, ++i);
             next();
             if (tk == ',') next();
           }
           next();
         }
-        *++e = ENT; *++e = i - loc;
+        *++e = ENT; *++e = nloc = i - loc; ent = e; nin = ltaken = 0;
+        if (loopt) addrs();
         while (tk != '}') stmt();
         *++e = LEV;
-        id = sym; // unwind symbol table locals
-        while (id[Tk]) {
-          if (id[Class] == Loc) {
-            id[Class] = id[HClass];
-            id[Type] = id[HType];
-            id[Val] = id[HVal];
-          }
-          id = id + Idsz;
+        tails(fs);
+        if (opt > 1) ir(fs);
+        if (opt) peep(fs);
+        inlinable(fn, fs, e);
+        while (nscope) { // unwind symbol table locals
+          id = (int *)scope[--nscope];
+          id[Class] = id[HClass];
+          id[Type] = id[HType];
+          id[Val] = id[HVal];
         }
       }
       else {
@@ -464,73 +4099,119 @@ int main(int argc, char **argv)
     next();
   }
 
-  if (!(pc = (int *)idmain[Val])) { printf("main() not defined\n"); return -1; }
-  if (src) return 0;
+  if (stats) {
+    printf("compile: %d lines, %d identifiers, %d buckets, %d lookups, %d.%02d probes/lookup, %d us\n",
+      line, nsym, symhm + 1, nlook, nprobe / (nlook + !nlook), nprobe * 100 / (nlook + !nlook) % 100,
+      (int)((clock() - ct) * 1000000 / CLOCKS_PER_SEC));
+    printf("rodata: %d literals, %d distinct, %d bytes\n", nlit, nstr, (int)(rodata - rodat0));
+    if (opt > 1) printf("ir: %d -> %d instructions, %d shared, %d dead stores\n", nir0, nir1, nircse, nirdead);
+    if (opt) printf("peephole: %d -> %d instructions\n", npeep0, npeep1);
+    if (inl) printf("inline: %d call sites\n", ninl);
+    printf("tail calls: %d\n", ntail);
+    if (loopt) printf("loops: %d rotated, %d unrolled, %d expressions hoisted\n", nrot, nunr, nhoist);
+  }
+  if (!(pc = (int *)((int *)cx[CxMain])[Val])) { printf("main() not defined\n"); return 0; }
+  relocs();
+  if (cache && !src) imsave(pc);
+  return pc;
+}
 
-  // setup stack
-  bp = sp = (int *)((int)sp + poolsz);
-  *--sp = EXIT; // call exit if main returns
-  *--sp = PSH; t = sp;
-  *--sp = argc;
-  *--sp = (int)argv;
-  *--sp = (int)t;
+// compile the source s into context x: 0, or -1 after reporting an error.
+// s need not outlive the call; x is left in the globals
+int c4compile(int *x, char *s)
+{
+  int *pc;
 
-  // run...
-  cycle = 0;
-  while (1) {
-    i = *pc++; ++cycle;
-    if (debug) {
-      printf("%d> %.4s", cycle,
-        &"LEA ,IMM ,JMP ,JSR ,BZ  ,BNZ ,ENT ,ADJ ,LEV ,LI  ,LC  ,SI  ,SC  ,PSH ,"
-         "OR  ,XOR ,AND ,EQ  ,NE  ,LT  ,GT  ,LE  ,GE  ,SHL ,SHR ,ADD ,SUB ,MUL ,DIV ,MOD ,NOT ,"
-         "OPEN,READ,CLOS,PRTF,MALC,FREE,MSET,MCMP,EXIT,"[i * 5]);
-      if (i <= ADJ) printf(" %d\n", *pc); else printf("\n");
+  pthread_mutex_lock(&cxm);
+  cxload(x);
+  pc = 0;
+  if (e != text) printf("program already compiled\n");
+  else if (!setjmp(cxerr)) x[CxPc] = (int)(pc = compile(s));
+  cxsave(x);
+  pthread_mutex_unlock(&cxm);
+  return pc ? 0 : -1;
+}
+
+// free context x, once every instance of it is freed
+void c4free(int *x)
+{
+  pthread_mutex_lock(&cxm);
+  unreserve((char *)x[CxSym]); unreserve((char *)x[CxText]); unreserve((char *)x[CxData0]); unreserve((char *)x[CxRo0]);
+  free((int *)x[CxSymh]); free((int *)x[CxStrh]); free((int *)x[CxRsec]); free((int *)x[CxCmap]); free((char *)x[CxCtext]);
+  if (cx == x) cx = 0;
+  free(x);
+  pthread_mutex_unlock(&cxm);
+}
+
+// the c4 command; -DC4LIB leaves it out to embed c4 through the calls in c4.h
+#ifndef C4LIB
+int main(int argc, char **argv)
+{
+  int fd;
+  struct sigaction sa;
+  stack_t ss;
+  int *pc, *sp; // vm registers
+
+  engine = 't'; cache = 1;
+  if (!(iotty = isatty(1))) setvbuf(stdout, 0, _IOFBF, IOBUF);
+  --argc; ++argv;
+  while (argc > 0 && **argv == '-' && (*argv)[1]) {
+    if ((*argv)[1] == 's') src = 1;
+    else if ((*argv)[1] == 'd') debug = 1;
+    else if ((*argv)[1] == 't') stats = 1;
+    else if ((*argv)[1] == 'l') lexb = 1;
+    else if ((*argv)[1] == 'H') hugepg = 1;
+    else if ((*argv)[1] == 'O') opt = ((*argv)[2] == '2') ? 2 : 1;
+    else if ((*argv)[1] == 'i') inl = (*argv)[2] ? atoi(*argv + 2) : 16;
+    else if ((*argv)[1] == 'L') loopt = 1;
+    else if ((*argv)[1] == 'p') {
+      if (!(hist = malloc((EXIT + 1) * (EXIT + 1) * sizeof(int)))) { printf("could not malloc histogram\n"); return -1; }
+      memset(hist, 0, (EXIT + 1) * (EXIT + 1) * sizeof(int));
     }
-    if      (i == LEA) a = (int)(bp + *pc++);                             // load local address
-    else if (i == IMM) a = *pc++;                                         // load global address or immediate
-    else if (i == JMP) pc = (int *)*pc;                                   // jump
-    else if (i == JSR) { *--sp = (int)(pc + 1); pc = (int *)*pc; }        // jump to subroutine
-    else if (i == BZ)  pc = a ? pc + 1 : (int *)*pc;                      // branch if zero
-    else if (i == BNZ) pc = a ? (int *)*pc : pc + 1;                      // branch if not zero
-    else if (i == ENT) { *--sp = (int)bp; bp = sp; sp = sp - *pc++; }     // enter subroutine
-    else if (i == ADJ) sp = sp + *pc++;                                   // stack adjust
-    else if (i == LEV) { sp = bp; bp = (int *)*sp++; pc = (int *)*sp++; } // leave subroutine
-    else if (i == LI)  a = *(int *)a;                                     // load int
-    else if (i == LC)  a = *(char *)a;                                    // load char
-    else if (i == SI)  *(int *)*sp++ = a;                                 // store int
-    else if (i == SC)  a = *(char *)*sp++ = a;                            // store char
-    else if (i == PSH) *--sp = a;                                         // push
-
-    else if (i == OR)  a = *sp++ |  a;
-    else if (i == XOR) a = *sp++ ^  a;
-    else if (i == AND) a = *sp++ &  a;
-    else if (i == EQ)  a = *sp++ == a;
-    else if (i == NE)  a = *sp++ != a;
-    else if (i == LT)  a = *sp++ <  a;
-    else if (i == GT)  a = *sp++ >  a;
-    else if (i == LE)  a = *sp++ <= a;
-    else if (i == GE)  a = *sp++ >= a;
-    else if (i == SHL) a = *sp++ << a;
-    else if (i == SHR) a = *sp++ >> a;
-    else if (i == ADD) a = *sp++ +  a;
-    else if (i == SUB) a = *sp++ -  a;
-    else if (i == MUL) a = *sp++ *  a;
-    else if (i == DIV) a = *sp++ /  a;
-    else if (i == MOD) a = *sp++ %  a;
-    else if (i == NOT) a = ~*sp++;  // added bitwise NOT
-    
-
-
-
-    else if (i == OPEN) a = open((char *)sp[1], *sp);
-    else if (i == READ) a = read(sp[2], (char *)sp[1], *sp);
-    else if (i == CLOS) a = close(*sp);
-    else if (i == PRTF) { t = sp + pc[1]; a = printf((char *)t[-1], t[-2], t[-3], t[-4], t[-5], t[-6]); }
-    else if (i == MALC) a = (int)malloc(*sp);
-    else if (i == FREE) free((void *)*sp);
-    else if (i == MSET) a = (int)memset((char *)sp[2], sp[1], *sp);
-    else if (i == MCMP) a = memcmp((char *)sp[2], (char *)sp[1], *sp);
-    else if (i == EXIT) { printf("exit(%d) cycle = %d\n", *sp, cycle); return *sp; }
-    else { printf("unknown instruction = %d! cycle = %d\n", i, cycle); return -1; }
+    else if ((*argv)[1] == 'j') engine = 'j';
+    else if ((*argv)[1] == 'C') cache = 0;
+    else if ((*argv)[1] == 'P') {
+      pruns = atoi(*argv + 2); npool = strchr(*argv, ':') ? atoi(strchr(*argv, ':') + 1) : 0;
+      if (pruns < 1) pruns = npool > 0 ? npool : sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    else if ((*argv)[1] == 'S' && argc > 1) { srvpath = *++argv; --argc; }
+    else if ((*argv)[1] == 'o' && argc > 1) { aot = 1; aotout = *++argv; --argc; }
+    else if ((*argv)[1] == 'x' && ((*argv)[2] == 's' || (*argv)[2] == 't' || (*argv)[2] == 'r' || (*argv)[2] == 'c')) engine = (*argv)[2];
+    else { printf("unknown option %s\n", *argv); return -1; }
+    --argc; ++argv;
+  }
+  if (argc < 1) { printf("usage: c4 [-s] [-d] [-t] [-l] [-H] [-O|-O2] [-i[n]] [-L] [-p] [-xs|-xt|-xr|-xc|-j] [-P[runs][:workers]] [-S socket] [-o exe] [-C] file|- ...\n"); return -1; }
+
+  if (**argv == '-' && !(*argv)[1]) fd = 0; // "-" reads the source from stdin
+  else if ((fd = open(*argv, 0)) < 0) { printf("could not open(%s)\n", *argv); return -1; }
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_sigaction = segv; sa.sa_flags = SA_SIGINFO;
+  if (engine == 'j') { // native code runs on the VM stack: take its faults on a stack of their own
+    if (!(ss.ss_sp = malloc(65536))) { printf("could not malloc signal stack\n"); return -1; }
+    ss.ss_size = 65536; ss.ss_flags = 0;
+    sigaltstack(&ss, 0);
+    sa.sa_flags = sa.sa_flags | SA_ONSTACK;
   }
+  sigaction(SIGSEGV, &sa, 0);
+  sp = (int *)reserve(256*1024*1024, "stack", 1, hugepg);
+  if (engine == 'r') rtext = (int *)reserve(1024*1024*1024, "register text", 0, hugepg);
+  if (engine == 'j' || aot) jcode = reserve(1024*1024*1024, "native code", 0, 0);
+  c4new();
+
+  if (source(fd) < 0) return -1;
+  if (fd) close(fd);
+
+  if (lexb) return lexbench();
+  if (c4compile(cx, p) < 0) return -1;
+  pc = (int *)cx[CxPc];
+  if (src) return (engine == 'r') ? regs() : 0;
+  if (aot) {
+    aotd = AOTRO + ((rodata - rodat0 + 4095) & -4096);
+    if (!jit(pc)) { printf("could not translate %s to native code\n", aotout); return -1; }
+    return elfout();
+  }
+
+  return start(pc, sp, argc, argv);
 }
+#endif
@@ -0,0 +1,18 @@
+// an inlined body with a loop inside an operand, at a ?: arm
+int *arr;
+
+int f3() { int i; i = 0; while (i < 3) i = i + 1; return i; }
+
+int main()
+{
+  int p0, x;
+
+  arr = malloc(8 * sizeof(int)); memset(arr, 0, 8 * sizeof(int));
+  p0 = 5;
+  arr[(16 ? --p0 : f3()) & 7] = 1;
+  printf("%d %d %d\n", p0, arr[4], arr[3]);
+  arr[(p0 ? f3() : --p0) & 7] = 2;
+  x = p0 + f3() * (p0 - f3());
+  printf("%d %d %d\n", p0, arr[3], x);
+  return 0;
+}
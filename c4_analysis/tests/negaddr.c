@@ -0,0 +1,15 @@
+// negaddr.c - negated addresses keep their relocations, so
+// they survive a warm start from the image cache and -o executables
+
+int g, h;
+
+int main()
+{
+  char *s;
+
+  s = "abc";
+  printf("%d %d\n", -(int)&g + (int)&g, -(int)&h + (int)&g + (int)&h - (int)&g);
+  printf("%d %d\n", -(int)s + (int)s, (int)s + -(int)&g - (int)s + (int)&g);
+  printf("%d\n", (int)&h - (int)&g);
+  return 0;
+}
@@ -0,0 +1,33 @@
+#!/bin/sh
+# run.sh - regression tests: every tests/*.c on every engine and option set,
+# warm from the image cache and as an executable written by -o, against its
+# .out (but not -o for programs that spawn tasks, which executables lack)
+#
+# usage: sh run.sh [c4 binary]
+# The exit(0) line the interpreters print is left out of the comparison.
+# Prints each failing program and option set.
+
+C4=${1:-./c4}
+DIR=$(dirname "$0")
+EXE=${TMPDIR:-/tmp}/c4_tests.$$
+export XDG_CACHE_HOME=$EXE.cache
+fail=0
+
+for f in "$DIR"/*.c; do
+  want=$(cat "${f%.c}.out")
+  for o in "" -xs -xr -xc -j -O -O2 "-O -i64" "-O2 -i" "-O2 -i64 -xr" "-O -i64 -xr" -L "-O2 -i -L" "-O2 -i -L -xc" "-O2 -i -L -xr"; do
+    got=$($C4 -C $o "$f" 2>&1 | grep -v '^exit(0)')
+    [ "$got" = "$want" ] || { echo "$(basename "$f") $o: wrong output"; fail=1; }
+  done
+  $C4 "$f" > /dev/null 2>&1
+  got=$($C4 "$f" 2>&1 | grep -v '^exit(0)')
+  [ "$got" = "$want" ] || { echo "$(basename "$f") warm: wrong output"; fail=1; }
+  if grep -q 'spawn(' "$f"; then :
+  elif $C4 -o $EXE "$f" > /dev/null && got=$($EXE 2>&1); then
+    [ "$got" = "$want" ] || { echo "$(basename "$f") -o: wrong output"; fail=1; }
+  else echo "$(basename "$f") -o: failed"; fail=1
+  fi
+done
+rm -rf $EXE $EXE.cache
+[ $fail = 0 ] && echo "all passed"
+exit $fail
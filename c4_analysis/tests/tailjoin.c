@@ -0,0 +1,26 @@
+// tailjoin.c - a returned call at the end of a ?: arm is not a tail call for
+// the other arm, which joins where the call's frame would be dropped
+
+int g() { return 12; }
+
+int h(int n) { return n + 100; }
+
+int f1(int c, int x) { return c ? x : g(); }
+
+int f2(int c, int x) { return c ? g() : x; }
+
+int f3(int c) { return c ? g() : h(c); }
+
+int f4(int c, int x) { return c ? x : h(x); }
+
+int f5(int c) { if (c) return g(); return h(c); }
+
+int main()
+{
+  printf("%d %d\n", f1(1, 3), f1(0, 3));
+  printf("%d %d\n", f2(1, 3), f2(0, 3));
+  printf("%d %d\n", f3(1), f3(0));
+  printf("%d %d\n", f4(1, 3), f4(0, 3));
+  printf("%d %d\n", f5(1), f5(0));
+  return 0;
+}
@@ -0,0 +1,11 @@
+// recursion too deep for a task's stack
+int down(int n) { if (n == 0) return 0; return 1 + down(n - 1); }
+
+int task(int n) { return down(n); }
+
+int main()
+{
+  printf("%d\n", join(spawn(task, 1000)));
+  printf("%d\n", join(spawn(task, 100000)));
+  return 0;
+}